@@ -0,0 +1,209 @@
+#include "analyse.h"
+#include "board.h"
+#include "thread.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Analyse {
+
+// The mapped file, handed out one line at a time
+struct Input {
+    const char* data = nullptr;
+    size_t size = 0;
+    size_t cursor = 0;  // Start of the next line
+    size_t next = 0;    // Its index among the non-empty lines
+    std::mutex mutex;
+    
+    // The next non-empty line and its index; false at the end of the file
+    bool take(std::string_view& line, size_t& index) {
+        std::lock_guard<std::mutex> lock(mutex);
+        while (cursor < size) {
+            const char* start = data + cursor;
+            const char* end = static_cast<const char*>(memchr(start, '\n', size - cursor));
+            size_t length = end ? end - start : size - cursor;
+            cursor += length + 1;
+            
+            std::string_view l(start, length);
+            while (!l.empty() && (l.back() == '\r' || l.back() == ' ' || l.back() == '\t')) {
+                l.remove_suffix(1);
+            }
+            if (l.empty()) continue;
+            
+            line = l;
+            index = next++;
+            return true;
+        }
+        return false;
+    }
+};
+
+// Finished lines waiting for their turn to be written
+struct Output {
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::map<size_t, std::string> pending;
+    int workersDone = 0;
+};
+
+// The FEN of an EPD line, or "" if it has no plausible position
+static std::string toFen(std::string_view line) {
+    std::istringstream in{std::string(line)};
+    std::string fields[6];
+    int n = 0;
+    while (n < 6 && in >> fields[n]) ++n;
+    if (n < 4) return "";
+    
+    // One king each, or the search has nothing sensible to do
+    if (std::count(fields[0].begin(), fields[0].end(), 'K') != 1
+        || std::count(fields[0].begin(), fields[0].end(), 'k') != 1
+        || (fields[1] != "w" && fields[1] != "b")) {
+        return "";
+    }
+    
+    auto isNumber = [](const std::string& s) {
+        return !s.empty() && std::all_of(s.begin(), s.end(), [](char c) { return c >= '0' && c <= '9'; });
+    };
+    std::string fen = fields[0] + " " + fields[1] + " " + fields[2] + " " + fields[3];
+    if (n == 6 && isNumber(fields[4]) && isNumber(fields[5])) {
+        return fen + " " + fields[4] + " " + fields[5];
+    }
+    return fen + " 0 1";
+}
+
+static void worker(const Options& options, Input& input, Output& output) {
+    ThreadPool pool;
+    pool.tt.resize(options.hashMB);
+    pool.silent = true;
+    Board board;
+    
+    std::string_view line;
+    size_t index;
+    while (input.take(line, index)) {
+        std::string result(line);
+        std::string fen = toFen(line);
+        if (!fen.empty()) {
+            board.setFromFEN(fen);
+            
+            // Fresh history for every position. The table only ages unless
+            // asked: clearing it is a pass over the whole table per line,
+            // which dominates shallow runs.
+            if (options.fresh) pool.clear();
+            else pool.clearHistory();
+            SearchLimits limits;
+            limits.depth = options.depth;
+            pool.think(board, limits);
+            
+            const SearchInfo& info = pool.mainInfo();
+            result += " ;acd " + std::to_string(info.completedDepth);
+            result += " ;acn " + std::to_string(pool.nodesSearched());
+            result += " ;ce " + std::to_string(info.score);
+            if (!info.pv.empty()) {
+                result += " ;pv";
+                for (Move m : info.pv) {
+                    result += " " + MoveUtils::toString(m);
+                }
+            }
+        }
+        
+        std::lock_guard<std::mutex> lock(output.mutex);
+        output.pending.emplace(index, std::move(result));
+        output.ready.notify_one();
+    }
+    
+    std::lock_guard<std::mutex> lock(output.mutex);
+    output.workersDone++;
+    output.ready.notify_one();
+}
+
+int run(const Options& options) {
+    int fd = ::open(options.input.c_str(), O_RDONLY);
+    if (fd == -1) {
+        std::cerr << "Cannot open " << options.input << std::endl;
+        return 1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        std::cerr << "Cannot read " << options.input << std::endl;
+        return 1;
+    }
+    
+    Input input;
+    input.size = st.st_size;
+    void* base = nullptr;
+    if (input.size) {
+        base = mmap(nullptr, input.size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (base == MAP_FAILED) {
+            ::close(fd);
+            std::cerr << "Cannot map " << options.input << std::endl;
+            return 1;
+        }
+        madvise(base, input.size, MADV_SEQUENTIAL);
+        input.data = static_cast<const char*>(base);
+    }
+    ::close(fd);
+    
+    // The first Board fills the shared lookup tables; do it before any
+    // worker races to
+    Board().reset();
+    
+    auto start = std::chrono::steady_clock::now();
+    int threads = std::max(1, options.threads);
+    Output output;
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; ++i) {
+        workers.emplace_back(worker, std::cref(options), std::ref(input), std::ref(output));
+    }
+    
+    // Write lines in input order as soon as each one's predecessors are out
+    size_t written = 0;
+    std::unique_lock<std::mutex> lock(output.mutex);
+    while (true) {
+        output.ready.wait(lock, [&] {
+            return output.pending.count(written) || output.workersDone == threads;
+        });
+        
+        std::vector<std::string> batch;
+        for (auto it = output.pending.find(written); it != output.pending.end() && it->first == written;
+             it = output.pending.erase(it), ++written) {
+            batch.push_back(std::move(it->second));
+        }
+        bool done = output.workersDone == threads && output.pending.empty();
+        
+        lock.unlock();
+        for (const std::string& line : batch) {
+            std::cout << line << '\n';
+        }
+        std::cout.flush();
+        lock.lock();
+        
+        if (done) break;
+    }
+    lock.unlock();
+    
+    for (std::thread& t : workers) {
+        t.join();
+    }
+    if (base) {
+        munmap(base, input.size);
+    }
+    
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "Analysed " << written << " lines in " << ms << " ms" << std::endl;
+    return 0;
+}
+
+}
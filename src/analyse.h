@@ -0,0 +1,35 @@
+#ifndef ANALYSE_H
+#define ANALYSE_H
+
+#include <string>
+
+// Offline analysis of an EPD file without the UCI round trip per position.
+//
+// The file is memory mapped and its lines handed out to worker threads,
+// each with its own single-threaded search and hash table. Every line is
+// searched to a fixed depth and written to stdout in input order, with the
+// analysis appended in the style of the perft suite:
+//
+//   <line> ;acd <depth> ;acn <nodes> ;ce <score> ;pv <moves>
+//
+// The score is in centipawns for the side to move, moves are in UCI
+// notation. A line's position is its first four EPD fields, plus the move
+// counters when they follow as in a FEN; lines without a legal-looking
+// position are copied through unchanged.
+namespace Analyse {
+
+struct Options {
+    std::string input;
+    int depth = 10;
+    int threads = 1;   // Workers, each searching one position at a time
+    int hashMB = 16;   // Per worker
+    bool fresh = false; // Clear the hash table before every position, so
+                        // results do not depend on the order lines are searched
+};
+
+// Returns 0 once every line is written, 1 if the file cannot be read
+int run(const Options& options);
+
+}
+
+#endif // ANALYSE_H
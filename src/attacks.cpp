@@ -1,4 +1,7 @@
 #include "attacks.h"
+#include "large_pages.h"
+#include "utils.h"
+#include <cstdlib>
 #include <iostream>
 
 namespace Attacks {
@@ -7,8 +10,19 @@ namespace Attacks {
 std::array<uint64_t, 64> knightAttacks;
 std::array<uint64_t, 64> kingAttacks;
 std::array<uint64_t, 64> pawnAttacks[2];
-std::array<std::array<uint64_t, 64>, 64> rookAttacks;
-std::array<std::array<uint64_t, 64>, 64> bishopAttacks;
+
+uint64_t betweenBB[64][64];
+uint64_t lineBB[64][64];
+
+// Magic entries and the shared attack tables they index into. The table
+// sizes are the sum of 2^popcount(mask) over all 64 squares. Both tables
+// live in one large-page block, so every slider lookup hits the same TLB
+// entry; the static arrays are only a fallback if that cannot be had.
+Magic rookMagics[64];
+Magic bishopMagics[64];
+constexpr size_t ROOK_TABLE_SIZE = 0x19000;
+constexpr size_t BISHOP_TABLE_SIZE = 0x1480;
+static uint64_t fallbackTable[ROOK_TABLE_SIZE + BISHOP_TABLE_SIZE];
 
 // Knight move deltas
 constexpr int KNIGHT_DELTAS[8] = {-17, -15, -10, -6, 6, 10, 15, 17};
@@ -16,7 +30,144 @@ constexpr int KNIGHT_DELTAS[8] = {-17, -15, -10, -6, 6, 10, 15, 17};
 // King move deltas  
 constexpr int KING_DELTAS[8] = {-9, -8, -7, -1, 1, 7, 8, 9};
 
+// Walk each ray from sq until the edge of the board or the first blocker
+uint64_t slidingAttacks(Square sq, uint64_t occupancy, const int* directions) {
+    uint64_t attacks = 0;
+    
+    for (int d = 0; d < 4; ++d) {
+        int dir = directions[d];
+        Square from = sq;
+        
+        while (true) {
+            int to = from + dir;
+            if (!isValidSquare(to)) break;
+            
+            // Stop if the step wrapped around to the other side of the board
+            if (abs(fileOf(to) - fileOf(from)) > 1) break;
+            
+            attacks = setBit(attacks, to);
+            if (testBit(occupancy, to)) break; // Blocked
+            from = to;
+        }
+    }
+    
+    return attacks;
+}
+
+// Magic multipliers from the usual sparse random search: for each square,
+// rooks a1..h8 then bishops a1..h8, candidates are rng() & rng() & rng()
+// from one std::mt19937_64 seeded with 20240101, skipped when the mask's
+// top byte after multiplying has fewer than 6 bits, and rejected until no
+// two occupancies that share an index have different attack sets. The
+// first candidate accepted is kept.
+static const uint64_t ROOK_MAGICS[64] = {
+    0x0880108000400022ULL, 0x8440042000100040ULL, 0x0200102080400a01ULL, 0x1180180014100080ULL,
+    0x0600020004082090ULL, 0x4400820820040010ULL, 0x1a000084080a0035ULL, 0x40800220d5000080ULL,
+    0x0000800080204000ULL, 0x1040401000200040ULL, 0x0018801004200080ULL, 0x3400801000800805ULL,
+    0x0500800400080080ULL, 0x0010800400020180ULL, 0x0149010004020001ULL, 0x0182800463800100ULL,
+    0x8400808000400028ULL, 0x0040404010002002ULL, 0x0901010040200014ULL, 0x0410008008001080ULL,
+    0x200a828008000401ULL, 0x0204808004000200ULL, 0x0080040042500108ULL, 0x44800200041040a1ULL,
+    0xc080004040002000ULL, 0x4010500040002000ULL, 0x0020012500144100ULL, 0x0016034200102108ULL,
+    0x0404110100080004ULL, 0x041a000200040810ULL, 0x0401100400080102ULL, 0x0481240200004889ULL,
+    0x0040204000800090ULL, 0x0800400080802010ULL, 0x8042004082001021ULL, 0x0000805001800800ULL,
+    0x0408080101000410ULL, 0x280a000400808002ULL, 0x2109302824008102ULL, 0x0051000041000082ULL,
+    0x0080004020004000ULL, 0x0001008200220040ULL, 0x0020200010008080ULL, 0x0010001009010022ULL,
+    0x000800800400800aULL, 0x020c008002008004ULL, 0x0e01000200010004ULL, 0x0441000080410022ULL,
+    0x80024004e0800480ULL, 0xb000401000200040ULL, 0x0008228210420600ULL, 0x0000380080100180ULL,
+    0x4600800400080080ULL, 0x1102008004000280ULL, 0x0042000401080200ULL, 0x1011000042008100ULL,
+    0x804150800100e841ULL, 0x8249004412008022ULL, 0x402100400a102005ULL, 0x0420994421001001ULL,
+    0x8202002010080502ULL, 0x1011000224002841ULL, 0x024400880f100244ULL, 0x2018002840841102ULL
+};
+
+static const uint64_t BISHOP_MAGICS[64] = {
+    0x0204308a28030010ULL, 0x0008810104010008ULL, 0x0409040102140110ULL, 0xa0080a0020001020ULL,
+    0x0002021010010011ULL, 0x4811012010001080ULL, 0x02c0809090108805ULL, 0x0000160490080808ULL,
+    0x1000081110020040ULL, 0x18202250411a0081ULL, 0x1010220204002288ULL, 0x0506024081008001ULL,
+    0x0b02020211002240ULL, 0x8484411002110021ULL, 0x8004041a18048482ULL, 0x8008104168082808ULL,
+    0x0020001020020098ULL, 0x0361000802408a04ULL, 0x0684012041022a00ULL, 0x0009002020408204ULL,
+    0x4009021820080800ULL, 0x1402000308060202ULL, 0x4802400421047004ULL, 0x5040800202010140ULL,
+    0x0804400820020408ULL, 0x20080424200408c1ULL, 0x4004120449080100ULL, 0x020508001b004100ULL,
+    0x7a10101001004000ULL, 0x00cf090002004112ULL, 0x00080908c0510800ULL, 0x0201010800442680ULL,
+    0x0002084001041043ULL, 0x4404010400091040ULL, 0x8088211008010400ULL, 0x00420a0080180180ULL,
+    0x2000620020820080ULL, 0x1210004444020100ULL, 0x8010040100146110ULL, 0x0008940500019480ULL,
+    0x0802211040080800ULL, 0x21104124a0001010ULL, 0x22800a00821a1003ULL, 0x012000a018006108ULL,
+    0x0401680100410400ULL, 0x200c300082000b08ULL, 0x002210020080060cULL, 0x100c090a02008120ULL,
+    0x1008540220111014ULL, 0x0400442401082220ULL, 0x4960062201500042ULL, 0x4840440020884401ULL,
+    0x0600014485040bc4ULL, 0x8110101210111400ULL, 0x0004101001211004ULL, 0x0010040084004c00ULL,
+    0x30128084101a0230ULL, 0x0044010088044240ULL, 0x0218000208940400ULL, 0x1020446100c20880ULL,
+    0x0024000c12020208ULL, 0x00500110a0011110ULL, 0x110021020c094401ULL, 0x0008020408020010ULL
+};
+
+// Build the magic entries for one slider type by enumerating every subset
+// of each square's relevant mask (Carry-Rippler) and storing the reference
+// attack set at its index
+static void initMagics(Magic magics[], uint64_t* table, const uint64_t* multipliers,
+                       const int* directions) {
+    uint64_t* next = table;
+    
+    for (Square sq = 0; sq < 64; ++sq) {
+        uint64_t rankEdges = (0xFFULL | (0xFFULL << 56)) & ~(0xFFULL << (8 * rankOf(sq)));
+        uint64_t fileEdges = (0x0101010101010101ULL | 0x8080808080808080ULL)
+                           & ~(0x0101010101010101ULL << fileOf(sq));
+        
+        Magic& m = magics[sq];
+        m.mask = slidingAttacks(sq, 0, directions) & ~(rankEdges | fileEdges);
+        m.magic = multipliers[sq];
+        m.shift = 64 - popcount(m.mask);
+        m.attacks = next;
+        
+        uint64_t b = 0;
+        do {
+            m.attacks[m.index(b)] = slidingAttacks(sq, b, directions);
+            b = (b - m.mask) & m.mask;
+        } while (b);
+        next += 1ULL << popcount(m.mask);
+    }
+}
+
+// Compare every slider lookup against the ray walker. Bits outside the
+// relevant mask are filled with noise to check they are ignored.
+static bool verifySliders() {
+    uint64_t noise = 1070372ull;
+    
+    for (Square sq = 0; sq < 64; ++sq) {
+        for (int pass = 0; pass < 2; ++pass) {
+            const Magic& m = pass == 0 ? rookMagics[sq] : bishopMagics[sq];
+            const int* directions = pass == 0 ? ROOK_DIRECTIONS : BISHOP_DIRECTIONS;
+            
+            uint64_t b = 0;
+            do {
+                noise ^= noise << 13;
+                noise ^= noise >> 7;
+                noise ^= noise << 17;
+                uint64_t occ = b | (noise & ~m.mask);
+                uint64_t expected = slidingAttacks(sq, occ, directions);
+                uint64_t actual = pass == 0 ? getRookAttacks(sq, occ) : getBishopAttacks(sq, occ);
+                if (actual != expected) {
+                    std::cerr << "Attacks: " << (pass == 0 ? "rook" : "bishop")
+                              << " table mismatch on " << squareToString(sq) << std::endl;
+                    return false;
+                }
+                b = (b - m.mask) & m.mask;
+            } while (b);
+        }
+    }
+    
+    return true;
+}
+
 void init() {
+    static bool initialized = false;
+    if (initialized) return;
+    initialized = true;
+    
+#ifdef USE_PEXT
+    if (!__builtin_cpu_supports("bmi2")) {
+        std::cerr << "This build uses PEXT but the CPU does not support BMI2" << std::endl;
+        std::exit(1);
+    }
+#endif
+    
     // Initialize knight attacks
     for (Square sq = 0; sq < 64; ++sq) {
         uint64_t attacks = 0;
@@ -93,70 +244,35 @@ void init() {
         pawnAttacks[BLACK][sq] = blackAttacks;
     }
     
-    // Initialize sliding piece attacks (simplified - can be optimized with magic bitboards later)
-    for (Square sq = 0; sq < 64; ++sq) {
-        for (int occupancyIndex = 0; occupancyIndex < 64; ++occupancyIndex) {
-            uint64_t occupancy = 0;
-            // Create a simple occupancy pattern for now
-            for (int i = 0; i < 6; ++i) {
-                if (occupancyIndex & (1 << i)) {
-                    occupancy = setBit(occupancy, (sq + i * 8 + i) % 64);
-                }
-            }
-            
-            // Compute rook attacks
-            uint64_t rookAtt = 0;
-            for (int dir : ROOK_DIRECTIONS) {
-                for (int i = 1; i < 8; ++i) {
-                    int to = sq + dir * i;
-                    if (!isValidSquare(to)) break;
-                    
-                    // Check for rank/file wrap
-                    if (dir == 1 || dir == -1) { // Horizontal
-                        if (rankOf(to) != rankOf(sq)) break;
-                    }
-                    
-                    rookAtt = setBit(rookAtt, to);
-                    if (testBit(occupancy, to)) break; // Blocked
-                }
-            }
-            rookAttacks[sq][occupancyIndex] = rookAtt;
+    // Initialize sliding piece attacks. The block is never released: the
+    // tables live as long as the process.
+    uint64_t* tables = static_cast<uint64_t*>(
+        LargePages::allocate((ROOK_TABLE_SIZE + BISHOP_TABLE_SIZE) * sizeof(uint64_t)));
+    if (!tables) tables = fallbackTable;
+    initMagics(rookMagics, tables, ROOK_MAGICS, ROOK_DIRECTIONS);
+    initMagics(bishopMagics, tables + ROOK_TABLE_SIZE, BISHOP_MAGICS, BISHOP_DIRECTIONS);
+    
+    // Startup self-check against the reference ray walker
+    if (!verifySliders()) {
+        std::abort();
+    }
+    
+    // Line and between tables for pin and check detection
+    for (Square a = 0; a < 64; ++a) {
+        for (Square b = 0; b < 64; ++b) {
+            betweenBB[a][b] = lineBB[a][b] = 0;
+            if (a == b) continue;
             
-            // Compute bishop attacks
-            uint64_t bishopAtt = 0;
-            for (int dir : BISHOP_DIRECTIONS) {
-                for (int i = 1; i < 8; ++i) {
-                    int to = sq + dir * i;
-                    if (!isValidSquare(to)) break;
-                    
-                    // Check for diagonal wrap
-                    int fileDiff = abs(fileOf(to) - fileOf(sq));
-                    int rankDiff = abs(rankOf(to) - rankOf(sq));
-                    if (fileDiff != i || rankDiff != i) break;
-                    
-                    bishopAtt = setBit(bishopAtt, to);
-                    if (testBit(occupancy, to)) break; // Blocked
-                }
+            uint64_t ends = squareBB(a) | squareBB(b);
+            if (getRookAttacks(a, 0) & squareBB(b)) {
+                lineBB[a][b] = (getRookAttacks(a, 0) & getRookAttacks(b, 0)) | ends;
+                betweenBB[a][b] = getRookAttacks(a, squareBB(b)) & getRookAttacks(b, squareBB(a));
+            } else if (getBishopAttacks(a, 0) & squareBB(b)) {
+                lineBB[a][b] = (getBishopAttacks(a, 0) & getBishopAttacks(b, 0)) | ends;
+                betweenBB[a][b] = getBishopAttacks(a, squareBB(b)) & getBishopAttacks(b, squareBB(a));
             }
-            bishopAttacks[sq][occupancyIndex] = bishopAtt;
         }
     }
 }
 
-uint64_t getRookAttacks(Square sq, uint64_t occupancy) {
-    // Simplified implementation - use a hash of occupancy for now
-    int index = occupancy % 64;
-    return rookAttacks[sq][index];
-}
-
-uint64_t getBishopAttacks(Square sq, uint64_t occupancy) {
-    // Simplified implementation - use a hash of occupancy for now  
-    int index = occupancy % 64;
-    return bishopAttacks[sq][index];
-}
-
-uint64_t getQueenAttacks(Square sq, uint64_t occupancy) {
-    return getRookAttacks(sq, occupancy) | getBishopAttacks(sq, occupancy);
-}
-
 }
\ No newline at end of file
@@ -4,6 +4,10 @@
 #include "types.h"
 #include <array>
 
+#ifdef USE_PEXT
+#include <immintrin.h>
+#endif
+
 // Precomputed attack tables for fast move generation
 namespace Attacks {
 
@@ -16,14 +20,36 @@ extern std::array<uint64_t, 64> kingAttacks;
 // Pawn attack tables - separate for each color
 extern std::array<uint64_t, 64> pawnAttacks[2];
 
-// Sliding piece attack tables (will be computed)
-extern std::array<std::array<uint64_t, 64>, 64> rookAttacks;
-extern std::array<std::array<uint64_t, 64>, 64> bishopAttacks;
+// Squares strictly between two aligned squares, and the full line through
+// them (both 0 if the squares do not share a rank, file or diagonal)
+extern uint64_t betweenBB[64][64];
+extern uint64_t lineBB[64][64];
 
 // Direction deltas for sliding pieces
 constexpr int ROOK_DIRECTIONS[4] = {-8, -1, 1, 8};
 constexpr int BISHOP_DIRECTIONS[4] = {-9, -7, 7, 9};
 
+// Fancy magic bitboard entry for a single square. With USE_PEXT the
+// relevant occupancy bits are extracted directly by BMI2 and the magic
+// multiplier is unused.
+struct Magic {
+    uint64_t mask;     // Relevant occupancy (rays without board edges)
+    uint64_t magic;
+    uint64_t* attacks; // Start of this square's slice of the attack table
+    unsigned shift;
+    
+    unsigned index(uint64_t occupancy) const {
+#ifdef USE_PEXT
+        return unsigned(_pext_u64(occupancy, mask));
+#else
+        return unsigned(((occupancy & mask) * magic) >> shift);
+#endif
+    }
+};
+
+extern Magic rookMagics[64];
+extern Magic bishopMagics[64];
+
 // Initialize all attack tables
 void init();
 
@@ -40,10 +66,43 @@ inline uint64_t getPawnAttacks(Square sq, Color c) {
     return pawnAttacks[c][sq];
 }
 
+inline uint64_t between(Square a, Square b) {
+    return betweenBB[a][b];
+}
+
+inline uint64_t line(Square a, Square b) {
+    return lineBB[a][b];
+}
+
 // Sliding piece attacks with occupancy
-uint64_t getRookAttacks(Square sq, uint64_t occupancy);
-uint64_t getBishopAttacks(Square sq, uint64_t occupancy);
-uint64_t getQueenAttacks(Square sq, uint64_t occupancy);
+inline uint64_t getRookAttacks(Square sq, uint64_t occupancy) {
+    const Magic& m = rookMagics[sq];
+    return m.attacks[m.index(occupancy)];
+}
+
+inline uint64_t getBishopAttacks(Square sq, uint64_t occupancy) {
+    const Magic& m = bishopMagics[sq];
+    return m.attacks[m.index(occupancy)];
+}
+
+inline uint64_t getQueenAttacks(Square sq, uint64_t occupancy) {
+    return getRookAttacks(sq, occupancy) | getBishopAttacks(sq, occupancy);
+}
+
+// Attacks of a non-pawn piece type from sq
+inline uint64_t getPieceAttacks(PieceType pt, Square sq, uint64_t occupancy) {
+    switch (pt) {
+        case KNIGHT: return getKnightAttacks(sq);
+        case BISHOP: return getBishopAttacks(sq, occupancy);
+        case ROOK:   return getRookAttacks(sq, occupancy);
+        case QUEEN:  return getQueenAttacks(sq, occupancy);
+        case KING:   return getKingAttacks(sq);
+        default:     return 0;
+    }
+}
+
+// Slow ray-walking reference for slider attacks (table setup and self-check)
+uint64_t slidingAttacks(Square sq, uint64_t occupancy, const int* directions);
 
 // Helper functions
 inline bool isValidSquare(int sq) {
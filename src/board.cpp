@@ -1,36 +1,87 @@
 #include "board.h"
+#include "attacks.h"
+#include "polyglot_keys.h"
+#include "psqt.h"
 #include "utils.h"
+#include <algorithm>
+#include <array>
 #include <cctype>
 #include <sstream>
 
-// Zobrist keys for hashing
+// Zobrist keys for hashing, the Polyglot book keys (polyglot_keys.h)
 static uint64_t zobristPieces[12][64];
 static uint64_t zobristCastling[16];
 static uint64_t zobristEpFile[8];
 static uint64_t zobristSideToMove;
+static uint64_t zobristNoPawns; // Pawn key base, so no pawn structure hashes to 0
 
 // Initialize Zobrist keys
 static void initZobrist() {
     static bool initialized = false;
     if (initialized) return;
     
-    for (int p = 0; p < 12; ++p) {
-        for (int s = 0; s < 64; ++s) {
-            zobristPieces[p][s] = random64();
+    for (Piece p = 0; p < 12; ++p) {
+        int kind = 2 * typeOf(p) + (colorOf(p) == WHITE);
+        for (Square s = 0; s < 64; ++s) {
+            zobristPieces[p][s] = POLYGLOT_RANDOM[64 * kind + s];
         }
     }
+    // One key per right, combined for each set of rights
     for (int i = 0; i < 16; ++i) {
-        zobristCastling[i] = random64();
+        zobristCastling[i] = 0;
+        for (int right = 0; right < 4; ++right) {
+            if (i & (1 << right)) zobristCastling[i] ^= POLYGLOT_RANDOM[768 + right];
+        }
     }
     for (int f = 0; f < 8; ++f) {
-        zobristEpFile[f] = random64();
+        zobristEpFile[f] = POLYGLOT_RANDOM[772 + f];
+    }
+    zobristSideToMove = POLYGLOT_RANDOM[780]; // Hashed in with white to move
+    zobristNoPawns = random64();
+    initialized = true;
+}
+
+// Cuckoo tables for upcoming repetition detection: every reversible move of
+// a non-pawn piece on an empty board, keyed by the change it makes to the
+// hash, in a cuckoo hash with two slots per key (3668 moves in 8192 slots)
+static uint64_t cuckooKeys[8192];
+static Move cuckooMoves[8192];
+
+static inline int cuckooH1(uint64_t key) { return key & 0x1fff; }
+static inline int cuckooH2(uint64_t key) { return (key >> 16) & 0x1fff; }
+
+static void initCuckoo() {
+    static bool initialized = false;
+    if (initialized) return;
+    
+    for (Piece p = 0; p < 12; ++p) {
+        PieceType pt = typeOf(p);
+        if (pt == PAWN) continue;
+        for (Square s1 = 0; s1 < 64; ++s1) {
+            for (Square s2 = s1 + 1; s2 < 64; ++s2) {
+                if (!Attacks::testBit(Attacks::getPieceAttacks(pt, s1, 0), s2)) continue;
+                
+                uint64_t key = zobristPieces[p][s1] ^ zobristPieces[p][s2] ^ zobristSideToMove;
+                Move move = MoveUtils::makeMove(s1, s2, 0);
+                int i = cuckooH1(key);
+                // Displace occupants into their other slot until one is empty
+                while (true) {
+                    std::swap(cuckooKeys[i], key);
+                    std::swap(cuckooMoves[i], move);
+                    if (move == 0) break;
+                    i = (i == cuckooH1(key)) ? cuckooH2(key) : cuckooH1(key);
+                }
+            }
+        }
     }
-    zobristSideToMove = random64();
     initialized = true;
 }
 
 Board::Board() {
     initZobrist();
+    Attacks::init();
+    PSQT::init();
+    initCuckoo();
     reset();
 }
 
@@ -43,6 +94,15 @@ void Board::setFromFEN(const std::string& fen) {
     for (int i = 0; i < 64; ++i) {
         squares[i] = NO_PIECE;
     }
+    for (int pt = 0; pt < 6; ++pt) {
+        byType[pt] = 0;
+    }
+    byColor[WHITE] = byColor[BLACK] = 0;
+    kingSq[WHITE] = kingSq[BLACK] = -1;
+    materialScore[WHITE] = materialScore[BLACK] = 0;
+    psqMg = psqEg = 0;
+    gamePhase = 0;
+    pawnKey = zobristNoPawns;
     
     std::vector<std::string> parts = split(fen);
     if (parts.size() < 4) return;
@@ -66,7 +126,7 @@ void Board::setFromFEN(const std::string& fen) {
                 case 'k': p = islower(c) ? BLACK_KING : WHITE_KING; break;
             }
             if (p != NO_PIECE) {
-                squares[makeSquare(file, rank)] = p;
+                putPiece(makeSquare(file, rank), p);
                 file++;
             }
         }
@@ -91,33 +151,46 @@ void Board::setFromFEN(const std::string& fen) {
         int f = parts[3][0] - 'a';
         int r = parts[3][1] - '1';
         epSquare = makeSquare(f, r);
+        // Only kept when a pawn can capture there, as in the hash
+        if (!(Attacks::getPawnAttacks(epSquare, 1 - stm) & pieces(stm, PAWN))) {
+            epSquare = -1;
+        }
     } else {
         epSquare = -1;
     }
     
     // Parse move counters
     halfmoves = (parts.size() > 4) ? std::stoi(parts[4]) : 0;
+    pliesFromNull = 0;
     fullmoves = (parts.size() > 5) ? std::stoi(parts[5]) : 1;
     
     // Calculate hash
     hash = 0;
-    for (int s = 0; s < 64; ++s) {
-        if (squares[s] != NO_PIECE) {
-            hash ^= zobristPieces[squares[s]][s];
-        }
+    uint64_t occ = occupied();
+    while (occ) {
+        Square s = popLsb(occ);
+        hash ^= zobristPieces[squares[s]][s];
     }
     hash ^= zobristCastling[castling];
     if (epSquare != -1) {
         hash ^= zobristEpFile[fileOf(epSquare)];
     }
-    if (stm == BLACK) {
+    if (stm == WHITE) {
         hash ^= zobristSideToMove;
     }
     
     // Clear history
     history.clear();
-    hashHistory.clear();
-    hashHistory.push_back(hash);
+    accumulators = nullptr;
+}
+
+void Board::initAccumulator(AccumulatorStack& stack) {
+    accumulators = nullptr;
+    if (!NNUE::enabled()) return;
+    
+    stack.clear();
+    NNUE::refresh(*this, stack.push());
+    accumulators = &stack;
 }
 
 std::string Board::toFEN() const {
@@ -178,7 +251,28 @@ std::string Board::toFEN() const {
     return ss.str();
 }
 
+// Castling rights kept by a move from or to each square: any move of the
+// king or a rook from its home square, or a capture there, drops the rights
+// that need it
+static constexpr std::array<int, 64> CASTLING_KEPT = [] {
+    std::array<int, 64> kept{};
+    for (int s = 0; s < 64; ++s) kept[s] = 15;
+    kept[E1] = ~(WHITE_KINGSIDE | WHITE_QUEENSIDE) & 15;
+    kept[E8] = ~(BLACK_KINGSIDE | BLACK_QUEENSIDE) & 15;
+    kept[A1] = ~WHITE_QUEENSIDE & 15;
+    kept[H1] = ~WHITE_KINGSIDE & 15;
+    kept[A8] = ~BLACK_QUEENSIDE & 15;
+    kept[H8] = ~BLACK_KINGSIDE & 15;
+    return kept;
+}();
+
+template <Color Us>
 void Board::makeMove(Move m) {
+    constexpr Color Them = 1 - Us;
+    constexpr int Up = Us == WHITE ? 8 : -8;
+    constexpr Square KingHome = Us == WHITE ? E1 : E8;
+    constexpr Piece OurRook = Us == WHITE ? WHITE_ROOK : BLACK_ROOK;
+    
     // Save undo info
     UndoInfo undo;
     undo.move = m;
@@ -186,12 +280,14 @@ void Board::makeMove(Move m) {
     undo.castling = castling;
     undo.epSquare = epSquare;
     undo.halfmoves = halfmoves;
+    undo.pliesFromNull = pliesFromNull;
     undo.hash = hash;
     
     Square from = MoveUtils::from(m);
     Square to = MoveUtils::to(m);
     Piece moving = squares[from];
     Piece captured = squares[to];
+    NNUE::DirtyPiece dirty;
     
     // Update hash for moving piece
     hash ^= zobristPieces[moving][from];
@@ -201,262 +297,341 @@ void Board::makeMove(Move m) {
     if (captured != NO_PIECE) {
         undo.captured = captured;
         hash ^= zobristPieces[captured][to];
+        clearSquare(to);
+        dirty.add(captured, to, -1);
     }
     
     // Move the piece
-    squares[to] = moving;
-    squares[from] = NO_PIECE;
+    movePiece(from, to);
+    if (!MoveUtils::isPromotion(m)) {
+        dirty.add(moving, from, to);
+    }
     
     // Handle special moves
     if (MoveUtils::isCastle(m)) {
-        // Move the rook
-        if (to == G1) { // White kingside
-            squares[F1] = WHITE_ROOK;
-            squares[H1] = NO_PIECE;
-            hash ^= zobristPieces[WHITE_ROOK][H1];
-            hash ^= zobristPieces[WHITE_ROOK][F1];
-        } else if (to == C1) { // White queenside
-            squares[D1] = WHITE_ROOK;
-            squares[A1] = NO_PIECE;
-            hash ^= zobristPieces[WHITE_ROOK][A1];
-            hash ^= zobristPieces[WHITE_ROOK][D1];
-        } else if (to == G8) { // Black kingside
-            squares[F8] = BLACK_ROOK;
-            squares[H8] = NO_PIECE;
-            hash ^= zobristPieces[BLACK_ROOK][H8];
-            hash ^= zobristPieces[BLACK_ROOK][F8];
-        } else if (to == C8) { // Black queenside
-            squares[D8] = BLACK_ROOK;
-            squares[A8] = NO_PIECE;
-            hash ^= zobristPieces[BLACK_ROOK][A8];
-            hash ^= zobristPieces[BLACK_ROOK][D8];
-        }
+        // The rook jumps to the square the king crossed
+        Square rookFrom = to > from ? KingHome + 3 : KingHome - 4;
+        Square rookTo = to > from ? KingHome + 1 : KingHome - 1;
+        movePiece(rookFrom, rookTo);
+        dirty.add(OurRook, rookFrom, rookTo);
+        hash ^= zobristPieces[OurRook][rookFrom];
+        hash ^= zobristPieces[OurRook][rookTo];
     } else if (MoveUtils::isEnPassant(m)) {
         // Remove captured pawn
-        Square captureSquare = makeSquare(fileOf(to), rankOf(from));
+        Square captureSquare = to - Up;
         undo.captured = squares[captureSquare];
         hash ^= zobristPieces[squares[captureSquare]][captureSquare];
-        squares[captureSquare] = NO_PIECE;
+        dirty.add(squares[captureSquare], captureSquare, -1);
+        clearSquare(captureSquare);
     } else if (MoveUtils::isPromotion(m)) {
         // Replace pawn with promoted piece
-        PieceType pt = MoveUtils::promotionType(m);
-        Piece promoted = makePiece(stm, pt);
-        squares[to] = promoted;
+        Piece promoted = makePiece(Us, MoveUtils::promotionType(m));
+        clearSquare(to);
+        putPiece(to, promoted);
+        dirty.add(moving, from, -1);
+        dirty.add(promoted, -1, to);
         hash ^= zobristPieces[moving][to];
         hash ^= zobristPieces[promoted][to];
     }
     
     // Update castling rights
-    hash ^= zobristCastling[castling];
-    updateCastlingRights(from, to);
-    hash ^= zobristCastling[castling];
+    int rights = castling & CASTLING_KEPT[from] & CASTLING_KEPT[to];
+    if (rights != castling) {
+        hash ^= zobristCastling[castling] ^ zobristCastling[rights];
+        castling = rights;
+    }
     
     // Update en passant square
     if (epSquare != -1) {
         hash ^= zobristEpFile[fileOf(epSquare)];
     }
     epSquare = -1;
-    if (typeOf(moving) == PAWN && abs(rankOf(to) - rankOf(from)) == 2) {
-        epSquare = makeSquare(fileOf(from), (rankOf(from) + rankOf(to)) / 2);
-        hash ^= zobristEpFile[fileOf(epSquare)];
+    // Set only when an enemy pawn can capture, so that positions which
+    // differ just by a useless double push share a key
+    bool pawnMove = typeOf(moving) == PAWN;
+    if (pawnMove && to - from == 2 * Up) {
+        Square ep = from + Up;
+        if (Attacks::getPawnAttacks(ep, Us) & pieces(Them, PAWN)) {
+            epSquare = ep;
+            hash ^= zobristEpFile[fileOf(epSquare)];
+        }
     }
     
     // Update move counters
     halfmoves++;
-    if (typeOf(moving) == PAWN || captured != NO_PIECE) {
+    pliesFromNull++;
+    if (pawnMove || captured != NO_PIECE) {
         halfmoves = 0;
     }
-    if (stm == BLACK) {
+    if constexpr (Us == BLACK) {
         fullmoves++;
     }
     
     // Switch side to move
-    stm = 1 - stm;
+    stm = Them;
     hash ^= zobristSideToMove;
     
     // Save state
-    history.push_back(undo);
-    hashHistory.push_back(hash);
+    history.push(undo);
+    
+    if (accumulators) {
+        NNUE::Accumulator& next = accumulators->push();
+        NNUE::update(accumulators->belowTop(), next, dirty, *this);
+    }
 }
 
+template <Color Us>
 void Board::unmakeMove(Move m) {
+    constexpr int Up = Us == WHITE ? 8 : -8;
+    constexpr Square KingHome = Us == WHITE ? E1 : E8;
+    
     // Restore from history
-    UndoInfo undo = history.back();
-    history.pop_back();
-    hashHistory.pop_back();
+    const UndoInfo& undo = history.pop();
+    if (accumulators && accumulators->size() > 1) {
+        accumulators->pop();
+    }
     
     // Switch side back
-    stm = 1 - stm;
+    stm = Us;
     
     // Restore simple fields
     castling = undo.castling;
     epSquare = undo.epSquare;
     halfmoves = undo.halfmoves;
+    pliesFromNull = undo.pliesFromNull;
     hash = undo.hash;
     
-    if (stm == BLACK) {
+    if constexpr (Us == BLACK) {
         fullmoves--;
     }
     
     // Move piece back
     Square from = MoveUtils::from(m);
     Square to = MoveUtils::to(m);
-    Piece moving = squares[to];
     
     // Handle promotion
     if (MoveUtils::isPromotion(m)) {
-        moving = makePiece(stm, PAWN);
+        clearSquare(to);
+        putPiece(to, makePiece(Us, PAWN));
     }
     
-    squares[from] = moving;
-    squares[to] = undo.captured;
+    movePiece(to, from);
     
     // Handle special moves
     if (MoveUtils::isCastle(m)) {
         // Move the rook back
-        if (to == G1) {
-            squares[H1] = WHITE_ROOK;
-            squares[F1] = NO_PIECE;
-        } else if (to == C1) {
-            squares[A1] = WHITE_ROOK;
-            squares[D1] = NO_PIECE;
-        } else if (to == G8) {
-            squares[H8] = BLACK_ROOK;
-            squares[F8] = NO_PIECE;
-        } else if (to == C8) {
-            squares[A8] = BLACK_ROOK;
-            squares[D8] = NO_PIECE;
-        }
+        Square rookFrom = to > from ? KingHome + 3 : KingHome - 4;
+        Square rookTo = to > from ? KingHome + 1 : KingHome - 1;
+        movePiece(rookTo, rookFrom);
     } else if (MoveUtils::isEnPassant(m)) {
         // Restore captured pawn
-        Square captureSquare = makeSquare(fileOf(to), rankOf(from));
-        squares[captureSquare] = undo.captured;
-        squares[to] = NO_PIECE;
+        putPiece(to - Up, undo.captured);
+    } else if (undo.captured != NO_PIECE) {
+        putPiece(to, undo.captured);
     }
 }
 
-void Board::updateCastlingRights(Square from, Square to) {
-    // Remove rights if king or rook moves
-    if (from == E1 || to == E1) {
-        castling &= ~(WHITE_KINGSIDE | WHITE_QUEENSIDE);
-    }
-    if (from == E8 || to == E8) {
-        castling &= ~(BLACK_KINGSIDE | BLACK_QUEENSIDE);
+template void Board::makeMove<WHITE>(Move m);
+template void Board::makeMove<BLACK>(Move m);
+template void Board::unmakeMove<WHITE>(Move m);
+template void Board::unmakeMove<BLACK>(Move m);
+
+Score Board::nonPawnMaterial(Color c) const {
+    return materialScore[c] - PSQT::PIECE_VALUES[PAWN] * popcount(pieces(c, PAWN));
+}
+
+void Board::makeNullMove() {
+    UndoInfo undo;
+    undo.move = 0;
+    undo.captured = NO_PIECE;
+    undo.castling = castling;
+    undo.epSquare = epSquare;
+    undo.halfmoves = halfmoves;
+    undo.pliesFromNull = pliesFromNull;
+    undo.hash = hash;
+    
+    if (epSquare != -1) {
+        hash ^= zobristEpFile[fileOf(epSquare)];
+        epSquare = -1;
     }
-    if (from == A1 || to == A1) {
-        castling &= ~WHITE_QUEENSIDE;
+    halfmoves++;
+    pliesFromNull = 0;
+    stm = 1 - stm;
+    hash ^= zobristSideToMove;
+    
+    history.push(undo);
+    
+    // No piece moved, so the accumulator carries over unchanged
+    if (accumulators) {
+        const NNUE::Accumulator& previous = accumulators->top();
+        accumulators->push() = previous;
     }
-    if (from == H1 || to == H1) {
-        castling &= ~WHITE_KINGSIDE;
+}
+
+void Board::unmakeNullMove() {
+    const UndoInfo& undo = history.pop();
+    if (accumulators && accumulators->size() > 1) {
+        accumulators->pop();
     }
-    if (from == A8 || to == A8) {
-        castling &= ~BLACK_QUEENSIDE;
+    
+    stm = 1 - stm;
+    epSquare = undo.epSquare;
+    halfmoves = undo.halfmoves;
+    pliesFromNull = undo.pliesFromNull;
+    hash = undo.hash;
+}
+
+void Board::putPiece(Square s, Piece p) {
+    uint64_t bb = Attacks::squareBB(s);
+    squares[s] = p;
+    byType[typeOf(p)] |= bb;
+    byColor[colorOf(p)] |= bb;
+    if (typeOf(p) == KING) {
+        kingSq[colorOf(p)] = s;
+    }
+    if (typeOf(p) == PAWN) {
+        pawnKey ^= zobristPieces[p][s];
+    }
+    materialScore[colorOf(p)] += PSQT::PIECE_VALUES[typeOf(p)];
+    psqMg += PSQT::mg[p][s];
+    psqEg += PSQT::eg[p][s];
+    gamePhase += PSQT::PHASE_WEIGHTS[typeOf(p)];
+}
+
+void Board::clearSquare(Square s) {
+    Piece p = squares[s];
+    uint64_t bb = Attacks::squareBB(s);
+    byType[typeOf(p)] &= ~bb;
+    byColor[colorOf(p)] &= ~bb;
+    squares[s] = NO_PIECE;
+    if (typeOf(p) == PAWN) {
+        pawnKey ^= zobristPieces[p][s];
+    }
+    materialScore[colorOf(p)] -= PSQT::PIECE_VALUES[typeOf(p)];
+    psqMg -= PSQT::mg[p][s];
+    psqEg -= PSQT::eg[p][s];
+    gamePhase -= PSQT::PHASE_WEIGHTS[typeOf(p)];
+}
+
+void Board::movePiece(Square from, Square to) {
+    Piece p = squares[from];
+    uint64_t fromTo = Attacks::squareBB(from) | Attacks::squareBB(to);
+    byType[typeOf(p)] ^= fromTo;
+    byColor[colorOf(p)] ^= fromTo;
+    squares[from] = NO_PIECE;
+    squares[to] = p;
+    if (typeOf(p) == KING) {
+        kingSq[colorOf(p)] = to;
     }
-    if (from == H8 || to == H8) {
-        castling &= ~BLACK_KINGSIDE;
+    if (typeOf(p) == PAWN) {
+        pawnKey ^= zobristPieces[p][from] ^ zobristPieces[p][to];
     }
+    psqMg += PSQT::mg[p][to] - PSQT::mg[p][from];
+    psqEg += PSQT::eg[p][to] - PSQT::eg[p][from];
 }
 
-Square Board::kingSquare(Color c) const {
-    Piece king = makePiece(c, KING);
-    for (int s = 0; s < 64; ++s) {
-        if (squares[s] == king) {
-            return s;
-        }
-    }
-    return -1; // Should never happen
+uint64_t Board::attackersTo(Square s, uint64_t occupancy) const {
+    return (Attacks::getPawnAttacks(s, BLACK) & pieces(WHITE, PAWN))
+         | (Attacks::getPawnAttacks(s, WHITE) & pieces(BLACK, PAWN))
+         | (Attacks::getKnightAttacks(s) & byType[KNIGHT])
+         | (Attacks::getBishopAttacks(s, occupancy) & (byType[BISHOP] | byType[QUEEN]))
+         | (Attacks::getRookAttacks(s, occupancy) & (byType[ROOK] | byType[QUEEN]))
+         | (Attacks::getKingAttacks(s) & byType[KING]);
 }
 
-bool Board::isAttacked(Square s, Color by) const {
-    // Check pawn attacks
-    int pawnDir = (by == WHITE) ? 8 : -8;
-    Piece pawn = makePiece(by, PAWN);
-    
-    // Pawn attacks from left and right
-    for (int delta : {pawnDir - 1, pawnDir + 1}) {
-        Square from = s - delta;
-        if (from >= 0 && from < 64 && abs(fileOf(from) - fileOf(s)) == 1) {
-            if (squares[from] == pawn) return true;
+// Enemy pieces giving check to the side to move
+uint64_t Board::checkers() const {
+    return attackersTo(kingSq[stm], occupied()) & byColor[1 - stm];
+}
+
+// Pieces of color c that are the only piece between their king and an
+// enemy slider
+uint64_t Board::pinnedPieces(Color c) const {
+    Square ksq = kingSq[c];
+    uint64_t theirs = byColor[1 - c];
+    uint64_t snipers = ((Attacks::getRookAttacks(ksq, 0) & (byType[ROOK] | byType[QUEEN]))
+                      | (Attacks::getBishopAttacks(ksq, 0) & (byType[BISHOP] | byType[QUEEN])))
+                     & theirs;
+    uint64_t occ = occupied();
+    uint64_t pinned = 0;
+    
+    while (snipers) {
+        uint64_t blockers = Attacks::between(ksq, popLsb(snipers)) & occ;
+        if (blockers && !(blockers & (blockers - 1))) {
+            pinned |= blockers & byColor[c];
         }
     }
     
-    // Knight attacks
-    const int knightMoves[] = {-17, -15, -10, -6, 6, 10, 15, 17};
-    Piece knight = makePiece(by, KNIGHT);
-    for (int delta : knightMoves) {
-        Square from = s + delta;
-        if (from >= 0 && from < 64) {
-            int fd = abs(fileOf(from) - fileOf(s));
-            int rd = abs(rankOf(from) - rankOf(s));
-            if (((fd == 2 && rd == 1) || (fd == 1 && rd == 2)) && 
-                squares[from] == knight) {
-                return true;
-            }
-        }
+    return pinned;
+}
+
+bool Board::see(Move m, Score threshold) const {
+    if (MoveUtils::isCastle(m) || MoveUtils::isEnPassant(m) || MoveUtils::isPromotion(m)) {
+        return 0 >= threshold;
     }
     
-    // Sliding pieces (bishop, rook, queen)
-    const int bishopDirs[] = {-9, -7, 7, 9};
-    const int rookDirs[] = {-8, -1, 1, 8};
-    
-    // Check bishop/queen diagonals
-    Piece bishop = makePiece(by, BISHOP);
-    Piece queen = makePiece(by, QUEEN);
-    for (int dir : bishopDirs) {
-        Square from = s;
-        int lastFile = fileOf(from);
-        while (true) {
-            from += dir;
-            if (from < 0 || from >= 64) break;
-            
-            // Check if we wrapped around the board
-            int currentFile = fileOf(from);
-            if (abs(currentFile - lastFile) != 1) break;
-            lastFile = currentFile;
-            
-            Piece p = squares[from];
-            if (p != NO_PIECE) {
-                if (p == bishop || p == queen) return true;
-                break;
-            }
-        }
-    }
+    Square from = MoveUtils::from(m);
+    Square to = MoveUtils::to(m);
     
-    // Check rook/queen lines  
-    Piece rook = makePiece(by, ROOK);
-    for (int dir : rookDirs) {
-        Square from = s;
-        while (true) {
-            from += dir;
-            if (from < 0 || from >= 64) break;
-            
-            // For horizontal moves, check we didn't wrap
-            if (abs(dir) == 1) {
-                if (rankOf(from) != rankOf(from - dir)) break;
-            }
-            
-            Piece p = squares[from];
-            if (p != NO_PIECE) {
-                if (p == rook || p == queen) return true;
-                break;
-            }
+    // swap is what the side to move stands to gain beyond the threshold
+    // if the exchange stops here; res flips with each capture
+    int swap = (squares[to] == NO_PIECE ? 0 : PSQT::PIECE_VALUES[typeOf(squares[to])]) - threshold;
+    if (swap < 0) return false;
+    
+    swap = PSQT::PIECE_VALUES[typeOf(squares[from])] - swap;
+    if (swap <= 0) return true;
+    
+    uint64_t occ = occupied() ^ Attacks::squareBB(from) ^ Attacks::squareBB(to);
+    uint64_t attackers = attackersTo(to, occ);
+    uint64_t diagonal = byType[BISHOP] | byType[QUEEN];
+    uint64_t straight = byType[ROOK] | byType[QUEEN];
+    Color side = stm;
+    int res = 1;
+    
+    while (true) {
+        side = 1 - side;
+        attackers &= occ;
+        uint64_t ours = attackers & byColor[side];
+        if (!ours) break;
+        res ^= 1;
+        
+        // Capture with the least valuable attacker, then add the sliders
+        // it uncovered behind it
+        PieceType pt = PAWN;
+        while (pt < KING && !(ours & byType[pt])) pt++;
+        if (pt == KING) {
+            // The king may only capture if nothing defends the square
+            return (attackers & ~byColor[side]) ? res ^ 1 : res;
         }
-    }
-    
-    // King attacks
-    const int kingDirs[] = {-9, -8, -7, -1, 1, 7, 8, 9};
-    Piece king = makePiece(by, KING);
-    for (int dir : kingDirs) {
-        Square from = s + dir;
-        if (from >= 0 && from < 64) {
-            if (abs(fileOf(from) - fileOf(s)) <= 1 && 
-                abs(rankOf(from) - rankOf(s)) <= 1 &&
-                squares[from] == king) {
-                return true;
-            }
+        
+        swap = PSQT::PIECE_VALUES[pt] - swap;
+        if (swap < res) break;
+        
+        occ ^= Attacks::squareBB(lsb(ours & byType[pt]));
+        if (pt == PAWN || pt == BISHOP || pt == QUEEN) {
+            attackers |= Attacks::getBishopAttacks(to, occ) & diagonal;
+        }
+        if (pt == ROOK || pt == QUEEN) {
+            attackers |= Attacks::getRookAttacks(to, occ) & straight;
         }
     }
     
+    return res != 0;
+}
+
+bool Board::isAttacked(Square s, Color by) const {
+    // A square is attacked by a pawn of 'by' if a pawn of the other color
+    // standing on it would attack that pawn
+    if (Attacks::getPawnAttacks(s, 1 - by) & pieces(by, PAWN)) return true;
+    if (Attacks::getKnightAttacks(s) & pieces(by, KNIGHT)) return true;
+    if (Attacks::getKingAttacks(s) & pieces(by, KING)) return true;
+    
+    // Sliding pieces (bishop, rook, queen)
+    uint64_t occ = occupied();
+    uint64_t queens = pieces(by, QUEEN);
+    if (Attacks::getBishopAttacks(s, occ) & (pieces(by, BISHOP) | queens)) return true;
+    if (Attacks::getRookAttacks(s, occ) & (pieces(by, ROOK) | queens)) return true;
+    
     return false;
 }
 
@@ -472,23 +647,193 @@ bool Board::isLegalMove(Move m) const {
     return !copy.isInCheck(1 - copy.sideToMove());
 }
 
-bool Board::isDrawByRepetition() const {
-    if (hashHistory.size() < 9) return false;
+bool Board::isPseudoLegal(Move m) const {
+    Square from = MoveUtils::from(m);
+    Square to = MoveUtils::to(m);
+    Piece pc = squares[from];
+    Piece target = squares[to];
+    
+    if (m == 0 || pc == NO_PIECE || colorOf(pc) != stm) return false;
+    
+    uint64_t toBB = Attacks::squareBB(to);
+    Color them = 1 - stm;
+    
+    if (MoveUtils::isCastle(m)) {
+        if (typeOf(pc) != KING || isAttacked(from, them)) return false;
+        
+        // Right, squares that must be empty, and square the king passes
+        int right;
+        uint64_t path;
+        Square pass;
+        if (from == E1 && to == G1)      { right = WHITE_KINGSIDE;  path = 0x60ULL;       pass = F1; }
+        else if (from == E1 && to == C1) { right = WHITE_QUEENSIDE; path = 0x0EULL;       pass = D1; }
+        else if (from == E8 && to == G8) { right = BLACK_KINGSIDE;  path = 0x60ULL << 56; pass = F8; }
+        else if (from == E8 && to == C8) { right = BLACK_QUEENSIDE; path = 0x0EULL << 56; pass = D8; }
+        else return false;
+        
+        return (castling & right) && !(occupied() & path)
+            && !isAttacked(pass, them) && !isAttacked(to, them);
+    }
+    
+    if (MoveUtils::isEnPassant(m)) {
+        return typeOf(pc) == PAWN && to == epSquare
+            && (Attacks::getPawnAttacks(from, stm) & toBB);
+    }
+    
+    // Apart from promotions, any other flag combination must be a plain
+    // move or capture
+    if (!MoveUtils::isPromotion(m) && MoveUtils::flags(m) != MOVE_NORMAL
+        && MoveUtils::flags(m) != MOVE_CAPTURE) {
+        return false;
+    }
+    
+    // The capture flag must match the target square
+    bool capture = MoveUtils::isCapture(m);
+    if (capture != (target != NO_PIECE)) return false;
+    if (capture && (colorOf(target) == stm || typeOf(target) == KING)) return false;
+    
+    if (typeOf(pc) == PAWN) {
+        bool lastRank = rankOf(to) == (stm == WHITE ? 7 : 0);
+        if (lastRank != MoveUtils::isPromotion(m)) return false;
+        
+        if (capture) return Attacks::getPawnAttacks(from, stm) & toBB;
+        
+        int up = (stm == WHITE) ? 8 : -8;
+        if (to == from + up) return true;
+        return to == from + 2 * up && rankOf(from) == (stm == WHITE ? 1 : 6)
+            && squares[from + up] == NO_PIECE;
+    }
+    
+    if (MoveUtils::isPromotion(m)) return false;
+    
+    return Attacks::getPieceAttacks(typeOf(pc), from, occupied()) & toBB;
+}
+
+bool Board::isLegal(Move m) const {
+    Square from = MoveUtils::from(m);
+    Square to = MoveUtils::to(m);
+    Square ksq = kingSq[stm];
+    uint64_t theirs = byColor[1 - stm];
+    
+    // Castling legality is fully checked by isPseudoLegal
+    if (MoveUtils::isCastle(m)) return true;
+    
+    if (MoveUtils::isEnPassant(m)) {
+        Square captureSquare = makeSquare(fileOf(to), rankOf(from));
+        uint64_t occ = (occupied() ^ Attacks::squareBB(from) ^ Attacks::squareBB(captureSquare))
+                     | Attacks::squareBB(to);
+        return !(attackersTo(ksq, occ) & theirs & ~Attacks::squareBB(captureSquare));
+    }
+    
+    // The king may not step onto an attacked square
+    if (from == ksq) {
+        return !(attackersTo(to, occupied() ^ Attacks::squareBB(from)) & theirs);
+    }
+    
+    // Other pieces must resolve a check and stay on their pin line
+    uint64_t check = checkers();
+    if (check) {
+        if (check & (check - 1)) return false;
+        if (!((Attacks::between(ksq, lsb(check)) | check) & Attacks::squareBB(to))) return false;
+    }
+    
+    return !(pinnedPieces(stm) & Attacks::squareBB(from))
+        || (Attacks::line(ksq, from) & Attacks::squareBB(to));
+}
+
+bool Board::givesCheck(Move m) const {
+    Square from = MoveUtils::from(m);
+    Square to = MoveUtils::to(m);
+    Square ksq = kingSq[1 - stm];
+    uint64_t kingBB = Attacks::squareBB(ksq);
+    uint64_t ours = byColor[stm];
+    uint64_t straight = (byType[ROOK] | byType[QUEEN]) & ours;
+    uint64_t diagonal = (byType[BISHOP] | byType[QUEEN]) & ours;
+    
+    // Only the rook can check: the king leaves the back rank's one line
+    if (MoveUtils::isCastle(m)) {
+        Square rookFrom = to > from ? from + 3 : from - 4;
+        Square rookTo = to > from ? from + 1 : from - 1;
+        uint64_t occ = (occupied() ^ Attacks::squareBB(from) ^ Attacks::squareBB(rookFrom))
+                     | Attacks::squareBB(to) | Attacks::squareBB(rookTo);
+        return Attacks::getRookAttacks(rookTo, occ) & kingBB;
+    }
+    
+    // Two pawns leave their squares, so any slider may be uncovered
+    if (MoveUtils::isEnPassant(m)) {
+        Square captureSquare = makeSquare(fileOf(to), rankOf(from));
+        uint64_t occ = (occupied() ^ Attacks::squareBB(from) ^ Attacks::squareBB(captureSquare))
+                     | Attacks::squareBB(to);
+        return (Attacks::getPawnAttacks(to, stm) & kingBB)
+            || (Attacks::getRookAttacks(ksq, occ) & straight)
+            || (Attacks::getBishopAttacks(ksq, occ) & diagonal);
+    }
+    
+    // Direct check by the piece landing on the target square
+    PieceType moved = MoveUtils::isPromotion(m) ? MoveUtils::promotionType(m) : typeOf(squares[from]);
+    uint64_t occ = (occupied() ^ Attacks::squareBB(from)) | Attacks::squareBB(to);
+    if (moved == PAWN ? Attacks::getPawnAttacks(to, stm) & kingBB
+                      : moved != KING && (Attacks::getPieceAttacks(moved, to, occ) & kingBB)) {
+        return true;
+    }
+    
+    // Discovered check: the piece was the only one between a slider of
+    // ours and their king, and leaves that line
+    if (Attacks::line(ksq, from) & Attacks::squareBB(to)) return false;
+    uint64_t snipers = (Attacks::getRookAttacks(ksq, 0) & straight)
+                     | (Attacks::getBishopAttacks(ksq, 0) & diagonal);
+    while (snipers) {
+        if ((Attacks::between(ksq, popLsb(snipers)) & occupied()) == Attacks::squareBB(from)) return true;
+    }
+    return false;
+}
+
+bool Board::isDrawByRepetition(int ply) const {
+    // Positions before the last capture, pawn move or null move cannot recur
+    int plies = history.size();
+    int end = std::min({halfmoves, pliesFromNull, plies});
     
     int count = 0;
-    uint64_t currentHash = hashHistory.back();
+    for (int i = 4; i <= end; i += 2) {
+        if (history[plies - i].hash == hash) {
+            if (i < ply) return true;  // Twofold inside the search tree
+            if (++count == 2) return true;
+        }
+    }
     
-    // Check for threefold repetition
-    for (size_t i = hashHistory.size() - 3; i > 0; i -= 2) {
-        if (hashHistory[i] == currentHash) {
-            count++;
-            if (count >= 2) return true;
+    return false;
+}
+
+bool Board::hasUpcomingRepetition(int ply) const {
+    int plies = history.size();
+    int end = std::min({halfmoves, pliesFromNull, plies, ply - 1});
+    if (end < 3) return false;
+    
+    uint64_t occ = occupied();
+    for (int i = 3; i <= end; i += 2) {
+        // The single move that would turn this position into that one
+        uint64_t moveKey = hash ^ history[plies - i].hash;
+        int slot = cuckooH1(moveKey);
+        if (cuckooKeys[slot] != moveKey) {
+            slot = cuckooH2(moveKey);
+            if (cuckooKeys[slot] != moveKey) continue;
+        }
+        
+        Move move = cuckooMoves[slot];
+        if (!(Attacks::between(MoveUtils::from(move), MoveUtils::to(move)) & occ)) {
+            return true;
         }
     }
     
     return false;
 }
 
+void Board::trimHistory() {
+    // Repetition lookups stop at the last irreversible or null move
+    int keep = std::min({halfmoves, pliesFromNull, history.size(), MAX_GAME_PLIES / 2});
+    history.keepLast(keep);
+}
+
 bool Board::isDrawByFiftyMoves() const {
     return halfmoves >= 100;
 }
\ No newline at end of file
@@ -3,11 +3,19 @@
 
 #include "types.h"
 #include "move.h"
+#include "nnue.h"
+#include <cassert>
+#include <cstring>
+#include <memory>
 #include <string>
-#include <vector>
 
 class Board {
 public:
+    // Undo stack capacity: game moves kept by position commands before the
+    // oldest are dropped, plus room for a search (Search::MAX_PLY) on top
+    static constexpr int MAX_GAME_PLIES = 1024;
+    static constexpr int MAX_STATES = MAX_GAME_PLIES + 256;
+    
     Board();
     
     // FEN operations
@@ -16,58 +24,228 @@ public:
     
     // Board state
     Piece pieceAt(Square s) const { return squares[s]; }
+    uint64_t pieces(Color c, PieceType pt) const { return byType[pt] & byColor[c]; }
+    uint64_t piecesByType(PieceType pt) const { return byType[pt]; }
+    uint64_t piecesByColor(Color c) const { return byColor[c]; }
+    uint64_t occupied() const { return byColor[WHITE] | byColor[BLACK]; }
     Color sideToMove() const { return stm; }
     int castlingRights() const { return castling; }
     Square enPassantSquare() const { return epSquare; }
     int halfmoveClock() const { return halfmoves; }
     int fullmoveNumber() const { return fullmoves; }
     
+    // Evaluation terms kept up to date by putPiece/clearSquare/movePiece
+    Score material(Color c) const { return materialScore[c]; }
+    Score nonPawnMaterial(Color c) const;
+    Score psqMidgame() const { return psqMg; } // White's point of view
+    Score psqEndgame() const { return psqEg; }
+    int phase() const { return gamePhase; }    // May exceed TOTAL_PHASE after promotions
+    
+    // One NNUE accumulator per ply from the position initAccumulator was
+    // called on. Owned by whoever searches the board (one per Search), and
+    // only allocated once NNUE is enabled. The search never goes deeper
+    // than Search::MAX_PLY, null moves included, so the undo stack's
+    // search room is enough.
+    class AccumulatorStack {
+    public:
+        static constexpr int CAPACITY = MAX_STATES - MAX_GAME_PLIES;
+        
+        AccumulatorStack() = default;
+        AccumulatorStack(const AccumulatorStack&) = delete;
+        AccumulatorStack& operator=(const AccumulatorStack&) = delete;
+        
+        // The new top, left for the caller to fill
+        NNUE::Accumulator& push() {
+            assert(count < CAPACITY);
+            return entries[count++];
+        }
+        void pop() {
+            assert(count > 0);
+            --count;
+        }
+        NNUE::Accumulator& top() { return entries[count - 1]; }
+        const NNUE::Accumulator& top() const { return entries[count - 1]; }
+        const NNUE::Accumulator& belowTop() const {
+            assert(count >= 2);
+            return entries[count - 2];
+        }
+        int size() const { return count; }
+        bool empty() const { return count == 0; }
+        
+        // Empty the stack, allocating it on first use
+        void clear() {
+            if (!entries) entries.reset(new NNUE::Accumulator[CAPACITY]);
+            count = 0;
+        }
+    
+    private:
+        std::unique_ptr<NNUE::Accumulator[]> entries;
+        int count = 0;
+    };
+    
+    // NNUE accumulator for the current position, kept up to date by
+    // makeMove/unmakeMove once initAccumulator attached a stack; nullptr
+    // when NNUE is off or on a copy of the board
+    void initAccumulator(AccumulatorStack& stack);
+    const NNUE::Accumulator* accumulator() const {
+        return accumulators && !accumulators->empty() ? &accumulators->top() : nullptr;
+    }
+    
     // Move operations
-    void makeMove(Move m);
-    void unmakeMove(Move m);
-    bool isLegalMove(Move m) const;
+    void makeMove(Move m) {
+        if (stm == WHITE) makeMove<WHITE>(m);
+        else makeMove<BLACK>(m);
+    }
+    void unmakeMove(Move m) {
+        if (stm == WHITE) unmakeMove<BLACK>(m);
+        else unmakeMove<WHITE>(m);
+    }
+    // Specialized for the side Us making or taking back the move
+    template <Color Us> void makeMove(Move m);
+    template <Color Us> void unmakeMove(Move m);
+    void makeNullMove();   // Pass the turn, for null move pruning
+    void unmakeNullMove();
+    int gamePly() const { return history.size(); } // Moves on the undo stack
+    void trimHistory(); // Drop the moves no repetition can reach back to
+    bool isLegalMove(Move m) const; // Copy-make test, used by the reference generator
+    bool isPseudoLegal(Move m) const; // Validates moves from the TT or killer slots
+    bool isLegal(Move m) const;       // Pin/check test for a pseudo-legal move
+    bool givesCheck(Move m) const;    // Whether a legal move checks, without making it
     
     // Position queries
     bool isInCheck(Color c) const;
     bool isAttacked(Square s, Color by) const;
-    Square kingSquare(Color c) const;
+    uint64_t attackersTo(Square s, uint64_t occupancy) const;
+    uint64_t checkers() const;
+    uint64_t pinnedPieces(Color c) const;
+    
+    // Static exchange evaluation: whether the exchange sequence started by
+    // move m on its target square wins at least threshold centipawns, with
+    // both sides recapturing with their least valuable piece, x-rays
+    // included. Castling, en passant and promotions count as 0.
+    bool see(Move m, Score threshold) const;
+    Square kingSquare(Color c) const { return kingSq[c]; }
     
     // Utility
     void reset();
-    bool isDrawByRepetition() const;
+    // The current position occurred before, looking back no further than
+    // the last irreversible move or null move. An occurrence within the first
+    // ply moves (inside the search tree) is enough; an earlier one must have
+    // occurred twice, so ply 0 asks for a threefold repetition.
+    bool isDrawByRepetition(int ply = 0) const;
+    // Side to move has a reversible move back to a position reached inside
+    // the search tree, so the score is at least a draw (cuckoo tables)
+    bool hasUpcomingRepetition(int ply) const;
     bool isDrawByFiftyMoves() const;
     uint64_t getHash() const { return hash; }
-    
+    uint64_t getPawnHash() const { return pawnKey; } // Zobrist key of the pawns only
+
 private:
     // Board representation
     Piece squares[64];
+    uint64_t byType[6];
+    uint64_t byColor[2];
+    Square kingSq[2];
     Color stm;
     int castling;
     Square epSquare;
     int halfmoves;
     int fullmoves;
+    int pliesFromNull; // Repetitions cannot span a null move
+    
+    // Incremental evaluation state
+    Score materialScore[2];
+    Score psqMg;
+    Score psqEg;
+    int gamePhase;
     
     // Position tracking
     uint64_t hash;
-    std::vector<uint64_t> hashHistory;
+    uint64_t pawnKey;
     
-    // Helper structures for unmake
+    // Helper structures for unmake: the state a move cannot restore by
+    // itself, saved before the move. The saved hashes double as the
+    // repetition history.
     struct UndoInfo {
-        Move move;
-        Piece captured;
-        int castling;
-        Square epSquare;
-        int halfmoves;
         uint64_t hash;
+        Move move;
+        int8_t captured;
+        uint8_t castling;
+        int8_t epSquare;
+        int16_t halfmoves;
+        int16_t pliesFromNull;
+    };
+    
+    // Fixed-capacity undo stack, so make/unmake never allocate. The object
+    // always reserves MAX_STATES entries (about 30 KB of every Board), but
+    // copies only memcpy the entries in use: a Board copy (SMP workers,
+    // copy-make legality) costs in proportion to the game history it holds.
+    class StateStack {
+    public:
+        StateStack() = default;
+        StateStack(const StateStack& other) { *this = other; }
+        StateStack& operator=(const StateStack& other) {
+            count = other.count;
+            std::memcpy(entries, other.entries, count * sizeof(UndoInfo));
+            return *this;
+        }
+        
+        void push(const UndoInfo& undo) {
+            assert(count < MAX_STATES);
+            entries[count++] = undo;
+        }
+        const UndoInfo& pop() {
+            assert(count > 0);
+            return entries[--count];
+        }
+        const UndoInfo& operator[](int i) const {
+            assert(i >= 0 && i < count);
+            return entries[i];
+        }
+        int size() const { return count; }
+        void clear() { count = 0; }
+        
+        // Keep only the newest n entries
+        void keepLast(int n) {
+            assert(n >= 0 && n <= count);
+            std::memmove(entries, entries + count - n, n * sizeof(UndoInfo));
+            count = n;
+        }
+    
+    private:
+        UndoInfo entries[MAX_STATES];
+        int count = 0;
+    };
+    StateStack history;
+    
+    // The attached accumulator stack. Copies of the board do not share it:
+    // they would push onto the owner's stack, so they evaluate from scratch.
+    class AccumulatorLink {
+    public:
+        AccumulatorLink() = default;
+        AccumulatorLink(const AccumulatorLink&) {}
+        AccumulatorLink& operator=(const AccumulatorLink&) {
+            stack = nullptr;
+            return *this;
+        }
+        AccumulatorLink& operator=(AccumulatorStack* s) {
+            stack = s;
+            return *this;
+        }
+        
+        explicit operator bool() const { return stack != nullptr; }
+        AccumulatorStack* operator->() const { return stack; }
+    
+    private:
+        AccumulatorStack* stack = nullptr;
     };
-    std::vector<UndoInfo> history;
+    AccumulatorLink accumulators;
     
     // Helper methods
     void clearSquare(Square s);
     void putPiece(Square s, Piece p);
     void movePiece(Square from, Square to);
     bool canCastle(int flag) const;
-    void updateCastlingRights(Square from, Square to);
 };
 
 #endif // BOARD_H
\ No newline at end of file
@@ -0,0 +1,110 @@
+#include "book.h"
+#include "movegen_fast.h"
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static uint64_t readBE(const uint8_t* p, int bytes) {
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; ++i) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+bool Book::open(const std::string& path) {
+    close();
+    
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1) return false;
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)ENTRY_SIZE || st.st_size % ENTRY_SIZE != 0) {
+        ::close(fd);
+        return false;
+    }
+    
+    void* base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) return false;
+    madvise(base, st.st_size, MADV_RANDOM);
+    
+    data = static_cast<const uint8_t*>(base);
+    mappedSize = st.st_size;
+    count = mappedSize / ENTRY_SIZE;
+    return true;
+}
+
+void Book::close() {
+    if (data) {
+        munmap(const_cast<uint8_t*>(data), mappedSize);
+    }
+    data = nullptr;
+    count = 0;
+    mappedSize = 0;
+}
+
+uint64_t Book::keyAt(size_t i) const {
+    return readBE(data + i * ENTRY_SIZE, 8);
+}
+
+// Book moves give the from and to squares in bits 6-11 and 0-5, and the
+// promotion piece (1 knight .. 4 queen) in bits 12-14. Castling is the
+// king taking its own rook, e1h1 for e1g1.
+Move Book::decode(const Board& board, uint16_t bookMove) const {
+    Square from = (bookMove >> 6) & 63;
+    Square to = bookMove & 63;
+    int promotion = (bookMove >> 12) & 7;
+    
+    MoveList legal;
+    DefaultMoveGenerator::generateLegalMoves(board, legal);
+    for (Move m : legal) {
+        if (MoveUtils::from(m) != from) continue;
+        
+        Square target = MoveUtils::to(m);
+        if (MoveUtils::isCastle(m)) {
+            target = makeSquare(fileOf(target) == 6 ? 7 : 0, rankOf(target));
+        }
+        if (target != to) continue;
+        
+        int piece = MoveUtils::isPromotion(m) ? MoveUtils::promotionType(m) : 0;
+        if (piece == promotion) return m;
+    }
+    return 0;
+}
+
+Move Book::probe(const Board& board) {
+    if (!data) return 0;
+    
+    // First entry of the position; all its entries follow
+    uint64_t key = board.getHash();
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (keyAt(mid) < key) lo = mid + 1;
+        else hi = mid;
+    }
+    
+    std::vector<std::pair<uint16_t, uint32_t>> moves;
+    uint64_t total = 0;
+    for (size_t i = lo; i < count && keyAt(i) == key; ++i) {
+        const uint8_t* entry = data + i * ENTRY_SIZE;
+        uint16_t move = readBE(entry + 8, 2);
+        uint32_t weight = readBE(entry + 10, 2);
+        moves.push_back({move, weight});
+        total += weight;
+    }
+    if (moves.empty()) return 0;
+    
+    // Weighted draw; a book of all-zero weights gives each move one chance
+    std::uniform_int_distribution<uint64_t> dist(0, total ? total - 1 : moves.size() - 1);
+    uint64_t pick = dist(rng);
+    for (const auto& [move, weight] : moves) {
+        uint64_t share = total ? weight : 1;
+        if (pick < share) return decode(board, move);
+        pick -= share;
+    }
+    return 0;
+}
@@ -0,0 +1,45 @@
+#ifndef BOOK_H
+#define BOOK_H
+
+#include "types.h"
+#include "move.h"
+#include "board.h"
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+
+// Polyglot opening book (.bin). The file is memory mapped read-only and
+// searched in place: it is a sorted array of 16-byte big-endian entries
+// (key, move, weight, learn), and positions are looked up by
+// Board::getHash(), which is the Polyglot key.
+class Book {
+public:
+    Book() : rng(std::random_device{}()) {}
+    ~Book() { close(); }
+    Book(const Book&) = delete;
+    Book& operator=(const Book&) = delete;
+    
+    // Map a book file, replacing any open book; false if it cannot be read
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return data != nullptr; }
+    size_t size() const { return count; }
+    
+    // A legal book move for the position, chosen at random in proportion
+    // to the entry weights; 0 if the position is not in the book
+    Move probe(const Board& board);
+
+private:
+    static constexpr size_t ENTRY_SIZE = 16;
+    
+    const uint8_t* data = nullptr;
+    size_t count = 0;
+    size_t mappedSize = 0;
+    std::mt19937_64 rng;
+    
+    uint64_t keyAt(size_t i) const;
+    Move decode(const Board& board, uint16_t bookMove) const;
+};
+
+#endif // BOOK_H
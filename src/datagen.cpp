@@ -0,0 +1,194 @@
+#include "datagen.h"
+#include "board.h"
+#include "movegen_fast.h"
+#include "thread.h"
+#include "utils.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace Datagen {
+
+// A game is adjudicated once the search sees one side this far ahead on
+// consecutive moves, or a draw once the score stays near zero late in the
+// game. Positions scored beyond the win margin are not written.
+constexpr Score WIN_SCORE = 1500;
+constexpr int WIN_PLIES = 4;
+constexpr Score DRAW_SCORE_MARGIN = 10;
+constexpr int DRAW_PLIES = 8;
+constexpr int DRAW_MIN_PLY = 80;
+constexpr int MAX_PLIES = 400;
+
+// Output shared by the workers
+struct Output {
+    std::ofstream file;
+    std::mutex mutex;
+    std::atomic<int> gamesStarted{0};
+    std::atomic<int> gamesDone{0};
+    std::atomic<uint64_t> positions{0};
+};
+
+// Kings alone, or with one minor piece, cannot mate
+static bool insufficientMaterial(const Board& board) {
+    int pieces = popcount(board.occupied());
+    if (pieces == 2) return true;
+    return pieces == 3 && (board.piecesByType(KNIGHT) | board.piecesByType(BISHOP));
+}
+
+// Play random legal moves from the start position; false if the game
+// ended on the way
+static bool randomOpening(Board& board, int plies, std::mt19937_64& rng) {
+    board.reset();
+    for (int i = 0; i < plies; ++i) {
+        MoveList moves;
+        DefaultMoveGenerator::generateLegalMoves(board, moves);
+        if (moves.empty()) return false;
+        std::uniform_int_distribution<int> pick(0, moves.size() - 1);
+        board.makeMove(moves[pick(rng)]);
+    }
+    MoveList moves;
+    DefaultMoveGenerator::generateLegalMoves(board, moves);
+    return !moves.empty();
+}
+
+// One self-play game; the result is 1.0, 0.5 or 0.0 for white
+static void playGame(ThreadPool& pool, const Options& options, std::mt19937_64& rng,
+                     std::vector<std::pair<std::string, Score>>& positions, double& result) {
+    Board board;
+    while (!randomOpening(board, options.randomPlies, rng)) {}
+    pool.clear();
+    positions.clear();
+    
+    int winPlies = 0, drawPlies = 0;
+    for (int ply = 0; ; ++ply) {
+        MoveList moves;
+        DefaultMoveGenerator::generateLegalMoves(board, moves);
+        if (moves.empty()) {
+            // Mated, or stalemate
+            result = !board.checkers() ? 0.5 : board.sideToMove() == WHITE ? 0.0 : 1.0;
+            return;
+        }
+        if (board.isDrawByFiftyMoves() || board.isDrawByRepetition() || insufficientMaterial(board)
+            || ply >= MAX_PLIES) {
+            result = 0.5;
+            return;
+        }
+        
+        SearchLimits limits;
+        limits.nodes = options.nodes;
+        Move best = pool.think(board, limits);
+        Score score = pool.mainInfo().score;
+        Score whiteScore = board.sideToMove() == WHITE ? score : -score;
+        
+        // Adjudication
+        winPlies = std::abs(score) >= WIN_SCORE ? winPlies + 1 : 0;
+        if (winPlies >= WIN_PLIES) {
+            result = whiteScore > 0 ? 1.0 : 0.0;
+            return;
+        }
+        drawPlies = ply >= DRAW_MIN_PLY && std::abs(score) <= DRAW_SCORE_MARGIN ? drawPlies + 1 : 0;
+        if (drawPlies >= DRAW_PLIES) {
+            result = 0.5;
+            return;
+        }
+        
+        // Only quiet positions: the static evaluation of a position in
+        // check or before a capture says little about its score
+        if (!board.checkers() && !MoveUtils::isCapture(best) && !MoveUtils::isPromotion(best)
+            && std::abs(score) < WIN_SCORE) {
+            positions.push_back({board.toFEN(), whiteScore});
+        }
+        
+        board.makeMove(best);
+        board.trimHistory();
+    }
+}
+
+static void worker(int id, const Options& options, Output& out) {
+    ThreadPool pool;
+    pool.tt.resize(options.hashMB);
+    pool.silent = true;
+    std::mt19937_64 rng(options.seed + id);
+    
+    std::vector<std::pair<std::string, Score>> positions;
+    std::string batch;
+    while (out.gamesStarted++ < options.games) {
+        double result = 0.5;
+        playGame(pool, options, rng, positions, result);
+        
+        const char* resultText = result == 1.0 ? "1.0" : result == 0.0 ? "0.0" : "0.5";
+        batch.clear();
+        for (const auto& [fen, score] : positions) {
+            batch += fen;
+            batch += " | ";
+            batch += std::to_string(score);
+            batch += " | ";
+            batch += resultText;
+            batch += '\n';
+        }
+        
+        std::lock_guard<std::mutex> lock(out.mutex);
+        out.file << batch;
+        out.positions += positions.size();
+        out.gamesDone++;
+    }
+}
+
+int run(const Options& options) {
+    std::vector<char> buffer(1 << 20); // Outlives the stream using it
+    Output out;
+    out.file.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+    out.file.open(options.output, std::ios::app);
+    if (!out.file) {
+        std::cerr << "Cannot open " << options.output << std::endl;
+        return 1;
+    }
+    
+    Options opts = options;
+    if (opts.seed == 0) opts.seed = std::random_device{}();
+    std::cout << "Datagen: " << opts.games << " games, " << opts.threads << " threads, "
+              << opts.nodes << " nodes per move, seed " << opts.seed << " -> " << opts.output << std::endl;
+    
+    // The first Board fills the shared lookup tables; do it before any
+    // worker races to
+    Board().reset();
+    
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int i = 0; i < opts.threads; ++i) {
+        workers.emplace_back(worker, i, std::cref(opts), std::ref(out));
+    }
+    
+    // Progress once a second until every worker is done
+    auto report = [&] {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        int64_t ms = std::max<int64_t>(1, std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count());
+        uint64_t positions = out.positions;
+        std::cerr << "Games " << out.gamesDone << "/" << opts.games << ", positions " << positions
+                  << ", " << positions * 1000 / ms << " positions/s" << std::endl;
+    };
+    auto lastReport = start;
+    while (out.gamesDone < opts.games) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (std::chrono::steady_clock::now() - lastReport >= std::chrono::seconds(1)) {
+            lastReport = std::chrono::steady_clock::now();
+            report();
+        }
+    }
+    for (std::thread& t : workers) {
+        t.join();
+    }
+    report();
+    
+    out.file.close();
+    return 0;
+}
+
+}
@@ -0,0 +1,34 @@
+#ifndef DATAGEN_H
+#define DATAGEN_H
+
+#include <cstdint>
+#include <string>
+
+// Self-play training data generation, run in-process on search threads.
+//
+// Each worker plays games against itself with its own single-threaded
+// search: a few random plies from the start position, then a fixed node
+// budget per move. Quiet positions are written as text lines
+//
+//   <fen> | <score> | <result>
+//
+// with the score in centipawns and the result (1.0, 0.5 or 0.0) both from
+// white's point of view. A game's lines are written together once it ends.
+namespace Datagen {
+
+struct Options {
+    std::string output = "data.txt";
+    int games = 100;
+    int threads = 1;
+    uint64_t nodes = 5000;  // Per move
+    int randomPlies = 8;    // Uniformly random opening moves
+    int hashMB = 16;        // Per worker
+    uint64_t seed = 0;      // 0 picks one at random
+};
+
+// Returns 0 once all games are written, 1 if the output cannot be opened
+int run(const Options& options);
+
+}
+
+#endif // DATAGEN_H
@@ -1,155 +1,80 @@
 #include "evaluation.h"
 #include "movegen.h"
+#include "nnue.h"
+#include "psqt.h"
+#include "stats.h"
+#include "tune.h"
+#include "utils.h"
+#include <algorithm>
 
-// Piece-square tables (from White's perspective)
-// These values encourage good piece placement
-const Score Evaluator::PAWN_PST[64] = {
-     0,  0,  0,  0,  0,  0,  0,  0,
-    50, 50, 50, 50, 50, 50, 50, 50,
-    10, 10, 20, 30, 30, 20, 10, 10,
-     5,  5, 10, 25, 25, 10,  5,  5,
-     0,  0,  0, 20, 20,  0,  0,  0,
-     5, -5,-10,  0,  0,-10, -5,  5,
-     5, 10, 10,-20,-20, 10, 10,  5,
-     0,  0,  0,  0,  0,  0,  0,  0
-};
+Score Evaluator::evaluate(const Board& board, Pawns::Table* pawns) {
+    STATS_TIMER(EVAL_CALLS);
 
-const Score Evaluator::KNIGHT_PST[64] = {
-    -50,-40,-30,-30,-30,-30,-40,-50,
-    -40,-20,  0,  0,  0,  0,-20,-40,
-    -30,  0, 10, 15, 15, 10,  0,-30,
-    -30,  5, 15, 20, 20, 15,  5,-30,
-    -30,  0, 15, 20, 20, 15,  0,-30,
-    -30,  5, 10, 15, 15, 10,  5,-30,
-    -40,-20,  0,  5,  5,  0,-20,-40,
-    -50,-40,-30,-30,-30,-30,-40,-50
-};
-
-const Score Evaluator::BISHOP_PST[64] = {
-    -20,-10,-10,-10,-10,-10,-10,-20,
-    -10,  0,  0,  0,  0,  0,  0,-10,
-    -10,  0,  5, 10, 10,  5,  0,-10,
-    -10,  5,  5, 10, 10,  5,  5,-10,
-    -10,  0, 10, 10, 10, 10,  0,-10,
-    -10, 10, 10, 10, 10, 10, 10,-10,
-    -10,  5,  0,  0,  0,  0,  5,-10,
-    -20,-10,-10,-10,-10,-10,-10,-20
-};
-
-const Score Evaluator::ROOK_PST[64] = {
-     0,  0,  0,  0,  0,  0,  0,  0,
-     5, 10, 10, 10, 10, 10, 10,  5,
-    -5,  0,  0,  0,  0,  0,  0, -5,
-    -5,  0,  0,  0,  0,  0,  0, -5,
-    -5,  0,  0,  0,  0,  0,  0, -5,
-    -5,  0,  0,  0,  0,  0,  0, -5,
-    -5,  0,  0,  0,  0,  0,  0, -5,
-     0,  0,  0,  5,  5,  0,  0,  0
-};
-
-const Score Evaluator::QUEEN_PST[64] = {
-    -20,-10,-10, -5, -5,-10,-10,-20,
-    -10,  0,  0,  0,  0,  0,  0,-10,
-    -10,  0,  5,  5,  5,  5,  0,-10,
-     -5,  0,  5,  5,  5,  5,  0, -5,
-      0,  0,  5,  5,  5,  5,  0, -5,
-    -10,  5,  5,  5,  5,  5,  0,-10,
-    -10,  0,  5,  0,  0,  0,  0,-10,
-    -20,-10,-10, -5, -5,-10,-10,-20
-};
-
-const Score Evaluator::KING_PST[64] = {
-    -30,-40,-40,-50,-50,-40,-40,-30,
-    -30,-40,-40,-50,-50,-40,-40,-30,
-    -30,-40,-40,-50,-50,-40,-40,-30,
-    -30,-40,-40,-50,-50,-40,-40,-30,
-    -20,-30,-30,-40,-40,-30,-30,-20,
-    -10,-20,-20,-20,-20,-20,-20,-10,
-     20, 20,  0,  0,  0,  0, 20, 20,
-     20, 30, 10,  0,  0, 10, 30, 20
-};
-
-const Score Evaluator::KING_ENDGAME_PST[64] = {
-    -50,-40,-30,-20,-20,-30,-40,-50,
-    -30,-20,-10,  0,  0,-10,-20,-30,
-    -30,-10, 20, 30, 30, 20,-10,-30,
-    -30,-10, 30, 40, 40, 30,-10,-30,
-    -30,-10, 30, 40, 40, 30,-10,-30,
-    -30,-10, 20, 30, 30, 20,-10,-30,
-    -30,-30,  0,  0,  0,  0,-30,-30,
-    -50,-30,-30,-30,-30,-30,-30,-50
-};
+#ifndef NO_EVAL
+    // A loaded network replaces the hand-written terms
+    if (NNUE::enabled()) {
+        const NNUE::Accumulator* acc = board.accumulator();
+        return acc ? NNUE::evaluate(*acc, board.sideToMove()) : NNUE::evaluate(board);
+    }
+#endif
 
-Score Evaluator::evaluate(const Board& board) {
     Score score = 0;
     
     // Always include material evaluation
     score += evaluateMaterial(board);
-    
+
 #ifndef NO_EVAL
     // Additional evaluation components
     score += evaluatePieceSquareTables(board);
     //score += evaluateMobility(board);
-    // Add other evaluation components as needed
-    // score += evaluatePawnStructure(board);
-    // score += evaluateKingSafety(board);
-#endif
     
+    Pawns::Entry local;
+    const Pawns::Entry* entry = &local;
+    if (pawns) {
+        entry = &pawns->probe(board);
+    } else {
+        Pawns::compute(board, local);
+    }
+    score += taper(board, entry->mg, entry->eg);
+    score += kingSafety(board, *entry);
+#endif
+
     // Return score from the perspective of the side to move
     return board.sideToMove() == WHITE ? score : -score;
 }
 
 Score Evaluator::evaluateMaterial(const Board& board) {
-    Score score = 0;
-    
-    for (Square sq = 0; sq < 64; ++sq) {
-        Piece p = board.pieceAt(sq);
-        if (p == NO_PIECE) continue;
-        
-        Score value = 0;
-        switch (typeOf(p)) {
-            case PAWN:   value = PAWN_VALUE; break;
-            case KNIGHT: value = KNIGHT_VALUE; break;
-            case BISHOP: value = BISHOP_VALUE; break;
-            case ROOK:   value = ROOK_VALUE; break;
-            case QUEEN:  value = QUEEN_VALUE; break;
-            case KING:   value = 0; break; // King has no material value
-        }
-        
-        if (colorOf(p) == WHITE) {
-            score += value;
-        } else {
-            score -= value;
-        }
-    }
-    
-    return score;
+    return board.material(WHITE) - board.material(BLACK);
 }
 
 Score Evaluator::evaluatePieceSquareTables(const Board& board) {
-    Score score = 0;
-    bool endgame = isEndgame(board);
-    
-    for (Square sq = 0; sq < 64; ++sq) {
-        Piece p = board.pieceAt(sq);
-        if (p == NO_PIECE) continue;
-        
-        Score psValue = getPieceSquareValue(p, sq, endgame);
-        if (colorOf(p) == WHITE) {
-            score += psValue;
-        } else {
-            score -= psValue;
-        }
+    return taper(board, board.psqMidgame(), board.psqEndgame());
+}
+
+// Blend middlegame and endgame scores by the remaining material
+Score Evaluator::taper(const Board& board, Score mg, Score eg) {
+    int phase = std::min(board.phase(), PSQT::TOTAL_PHASE);
+    return (mg * phase + eg * (PSQT::TOTAL_PHASE - phase)) / PSQT::TOTAL_PHASE;
+}
+
+Score Evaluator::kingSafety(const Board& board, const Pawns::Entry& pawns) {
+    Score mg = 0;
+    for (Color c : {WHITE, BLACK}) {
+        Square ksq = board.kingSquare(c);
+        Rank relRank = c == WHITE ? rankOf(ksq) : 7 - rankOf(ksq);
+        Score s = relRank <= 1 ? pawns.shelter[c][fileOf(ksq)] : KING_EXPOSED;
+        mg += c == WHITE ? s : -s;
+        if (relRank <= 1) TUNE_SET(kingFile[c], fileOf(ksq));
+        else TUNE_ADD(exposed, c == WHITE ? 1 : -1);
     }
-    
-    return score;
+    return taper(board, mg, 0);
 }
 
 Score Evaluator::evaluateMobility(const Board& board) {
     Score score = 0;
     
     // Generate moves once for the entire position
-    std::vector<Move> moves;
+    MoveList moves;
     MoveGenerator::generateLegalMoves(board, moves);
     
     // Count moves for each piece
@@ -176,61 +101,13 @@ Score Evaluator::evaluateMobility(const Board& board) {
 }
 
 Score Evaluator::evaluatePawnStructure(const Board& board) {
-    // TODO: Implement pawn structure evaluation
-    // - Doubled pawns
-    // - Isolated pawns
-    // - Passed pawns
-    // - Pawn chains
-    return 0;
+    Pawns::Entry entry;
+    Pawns::compute(board, entry);
+    return taper(board, entry.mg, entry.eg);
 }
 
 Score Evaluator::evaluateKingSafety(const Board& board) {
-    // TODO: Implement king safety evaluation
-    // - Pawn shield
-    // - King exposure
-    // - Attacking pieces near king
-    return 0;
+    Pawns::Entry entry;
+    Pawns::compute(board, entry);
+    return kingSafety(board, entry);
 }
-
-Score Evaluator::getPieceSquareValue(Piece p, Square s, bool endgame) {
-    // For black pieces, we need to flip the square vertically
-    Square sq = colorOf(p) == WHITE ? s : s ^ 56;
-    
-    switch (typeOf(p)) {
-        case PAWN:   return PAWN_PST[sq];
-        case KNIGHT: return KNIGHT_PST[sq];
-        case BISHOP: return BISHOP_PST[sq];
-        case ROOK:   return ROOK_PST[sq];
-        case QUEEN:  return QUEEN_PST[sq];
-        case KING:   return endgame ? KING_ENDGAME_PST[sq] : KING_PST[sq];
-        default:     return 0;
-    }
-}
-
-bool Evaluator::isEndgame(const Board& board) {
-    // Simple endgame detection based on material count
-    int whiteMaterial = countMaterial(board, WHITE);
-    int blackMaterial = countMaterial(board, BLACK);
-    
-    // Consider it endgame if total material is less than rook + bishop + knight
-    return (whiteMaterial + blackMaterial) < (ROOK_VALUE + BISHOP_VALUE + KNIGHT_VALUE + 6 * PAWN_VALUE);
-}
-
-int Evaluator::countMaterial(const Board& board, Color c) {
-    int material = 0;
-    
-    for (Square sq = 0; sq < 64; ++sq) {
-        Piece p = board.pieceAt(sq);
-        if (p != NO_PIECE && colorOf(p) == c) {
-            switch (typeOf(p)) {
-                case PAWN:   material += PAWN_VALUE; break;
-                case KNIGHT: material += KNIGHT_VALUE; break;
-                case BISHOP: material += BISHOP_VALUE; break;
-                case ROOK:   material += ROOK_VALUE; break;
-                case QUEEN:  material += QUEEN_VALUE; break;
-            }
-        }
-    }
-    
-    return material;
-}
\ No newline at end of file
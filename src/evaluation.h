@@ -3,11 +3,16 @@
 
 #include "types.h"
 #include "board.h"
+#include "pawns.h"
 
 class Evaluator {
 public:
-    // Main evaluation function
-    static Score evaluate(const Board& board);
+    // King shelter only counts while the king stays home; otherwise a flat
+    // penalty, both scaled down as material comes off
+    static constexpr Score KING_EXPOSED = -40;
+    
+    // Main evaluation function; pawn terms come from the cache when given
+    static Score evaluate(const Board& board, Pawns::Table* pawns = nullptr);
     
     // Evaluation components (for tuning/debugging)
     static Score evaluateMaterial(const Board& board);
@@ -15,28 +20,10 @@ public:
     static Score evaluateMobility(const Board& board);
     static Score evaluatePawnStructure(const Board& board);
     static Score evaluateKingSafety(const Board& board);
-    
+
 private:
-    // Material values
-    static constexpr Score PAWN_VALUE = 100;
-    static constexpr Score KNIGHT_VALUE = 320;
-    static constexpr Score BISHOP_VALUE = 330;
-    static constexpr Score ROOK_VALUE = 500;
-    static constexpr Score QUEEN_VALUE = 900;
-    
-    // Piece-square tables
-    static const Score PAWN_PST[64];
-    static const Score KNIGHT_PST[64];
-    static const Score BISHOP_PST[64];
-    static const Score ROOK_PST[64];
-    static const Score QUEEN_PST[64];
-    static const Score KING_PST[64];
-    static const Score KING_ENDGAME_PST[64];
-    
-    // Helper methods
-    static Score getPieceSquareValue(Piece p, Square s, bool endgame = false);
-    static bool isEndgame(const Board& board);
-    static int countMaterial(const Board& board, Color c);
+    static Score taper(const Board& board, Score mg, Score eg);
+    static Score kingSafety(const Board& board, const Pawns::Entry& pawns);
 };
 
 #endif // EVALUATION_H
\ No newline at end of file
@@ -0,0 +1,55 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "types.h"
+#include "move.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+// Quiet move ordering statistics, one set per search thread.
+//
+// Entries are updated with a "gravity" formula: a bonus is scaled down as
+// the entry approaches HISTORY_MAX, so values saturate in
+// [-HISTORY_MAX, HISTORY_MAX] and old results fade as new ones arrive,
+// without a periodic rescaling pass.
+constexpr int HISTORY_MAX = 16384;
+
+inline void updateHistory(int16_t& entry, int bonus) {
+    entry += int16_t(bonus - entry * std::abs(bonus) / HISTORY_MAX);
+}
+
+// Bonus for a quiet move that caused a cutoff at the given depth; the
+// quiets searched before it receive the same amount as a malus
+inline int historyBonus(int depth) {
+    return std::min(32 * depth * depth, 1600);
+}
+
+// Butterfly history: [color][from][to]
+struct alignas(64) ButterflyHistory {
+    int16_t table[2][64][64];
+    
+    int16_t& at(Color c, Move m) { return table[c][MoveUtils::from(m)][MoveUtils::to(m)]; }
+    int16_t get(Color c, Move m) const { return table[c][MoveUtils::from(m)][MoveUtils::to(m)]; }
+    void clear() { std::memset(table, 0, sizeof(table)); }
+};
+
+// History of a move [piece][to], given some earlier move
+using PieceToHistory = int16_t[12][64];
+
+// Continuation history: [previous piece][previous to] -> PieceToHistory.
+// The same table serves the moves one and two plies back.
+struct alignas(64) ContinuationHistory {
+    PieceToHistory table[12][64];
+    
+    void clear() { std::memset(table, 0, sizeof(table)); }
+};
+
+// The quiet reply that last refuted a move: [piece][to]
+struct alignas(64) CounterMoveTable {
+    Move table[12][64];
+    
+    void clear() { std::memset(table, 0, sizeof(table)); }
+};
+
+#endif // HISTORY_H
@@ -0,0 +1,52 @@
+#include "large_pages.h"
+#include <cstdint>
+#include <sys/mman.h>
+
+namespace LargePages {
+
+constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+static size_t roundUp(size_t bytes) {
+    return (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+}
+
+void* allocate(size_t bytes) {
+    size_t size = roundUp(bytes);
+
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_2MB)
+    // Reserved huge pages (vm.nr_hugepages), if there are enough
+    void* huge = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_2MB, -1, 0);
+    if (huge != MAP_FAILED) return huge;
+#endif
+
+    // Otherwise map one page more than needed and trim both ends back to
+    // a 2 MB boundary, which transparent huge pages require
+    size_t mapped = size + HUGE_PAGE_SIZE;
+    void* base = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) return nullptr;
+    
+    char* raw = static_cast<char*>(base);
+    char* aligned = reinterpret_cast<char*>(
+        (reinterpret_cast<uintptr_t>(raw) + HUGE_PAGE_SIZE - 1) & ~uintptr_t(HUGE_PAGE_SIZE - 1));
+    if (aligned > raw) {
+        munmap(raw, aligned - raw);
+    }
+    char* end = aligned + size;
+    if (raw + mapped > end) {
+        munmap(end, raw + mapped - end);
+    }
+
+#ifdef MADV_HUGEPAGE
+    madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+    return aligned;
+}
+
+void release(void* memory, size_t bytes) {
+    if (memory) {
+        munmap(memory, roundUp(bytes));
+    }
+}
+
+}
@@ -0,0 +1,22 @@
+#ifndef LARGE_PAGES_H
+#define LARGE_PAGES_H
+
+#include <cstddef>
+
+// Memory for large, long-lived tables (the TT, the slider attack tables)
+// in 2 MB pages, so a lookup costs fewer TLB misses. Explicit huge pages
+// (MAP_HUGETLB) are used when the system has some reserved, otherwise 2 MB
+// aligned memory marked for transparent huge pages. The memory comes back
+// zeroed and untouched: each page lands on the NUMA node of the thread
+// that first writes it.
+namespace LargePages {
+
+// At least bytes, rounded up to whole 2 MB pages; nullptr on failure
+void* allocate(size_t bytes);
+
+// Free memory from allocate() of the same size
+void release(void* memory, size_t bytes);
+
+}
+
+#endif // LARGE_PAGES_H
@@ -3,11 +3,12 @@
 
 #include "types.h"
 #include <string>
+#include <utility>
 
 // Move encoding: 16 bits
 // bits 0-5: from square
 // bits 6-11: to square
-// bits 12-15: flags (promotion piece, special moves)
+// bits 12-15: flags (promotion piece, special moves), see types.h
 
 class MoveUtils {
 public:
@@ -27,6 +28,62 @@ public:
     static Move fromString(const std::string& str);
 };
 
+// Fixed-capacity move list with a parallel score array for move ordering.
+// Lives on the stack, so generating and ordering moves never allocates.
+class MoveList {
+public:
+    static constexpr int MAX_MOVES = 256; // Above the 218 legal moves possible in any position
+    
+    void push_back(Move m) { moves[count++] = m; }
+    void clear() { count = 0; }
+    int size() const { return count; }
+    bool empty() const { return count == 0; }
+    
+    Move& operator[](int i) { return moves[i]; }
+    Move operator[](int i) const { return moves[i]; }
+    Score& score(int i) { return scores[i]; }
+    
+    Move* begin() { return moves; }
+    Move* end() { return moves + count; }
+    const Move* begin() const { return moves; }
+    const Move* end() const { return moves + count; }
+    
+    // Drop the move at index i by moving the last move into its place
+    void removeAt(int i) { moves[i] = moves[--count]; scores[i] = scores[count]; }
+    
+    // Selection step for lazy ordering: swap the best scoring move in
+    // [i, size) into slot i
+    void pickBest(int i) {
+        int best = i;
+        for (int j = i + 1; j < count; ++j) {
+            if (scores[j] > scores[best]) best = j;
+        }
+        std::swap(moves[i], moves[best]);
+        std::swap(scores[i], scores[best]);
+    }
+    
+    // Stable insertion sort by descending score; equal scores keep their
+    // generation order
+    void sortByScore() {
+        for (int i = 1; i < count; ++i) {
+            Move m = moves[i];
+            Score s = scores[i];
+            int j = i - 1;
+            for (; j >= 0 && scores[j] < s; --j) {
+                moves[j + 1] = moves[j];
+                scores[j + 1] = scores[j];
+            }
+            moves[j + 1] = m;
+            scores[j + 1] = s;
+        }
+    }
+    
+private:
+    Move moves[MAX_MOVES];
+    Score scores[MAX_MOVES];
+    int count = 0;
+};
+
 inline Move MoveUtils::makeMove(Square from, Square to, uint16_t flags) {
     return from | (to << 6) | flags;
 }
@@ -48,11 +105,11 @@ inline bool MoveUtils::isCapture(Move m) {
 }
 
 inline bool MoveUtils::isCastle(Move m) {
-    return (m & 0xC000) == MOVE_CASTLE;
+    return (m & 0xF000) == MOVE_CASTLE;
 }
 
 inline bool MoveUtils::isEnPassant(Move m) {
-    return (m & 0xC000) == MOVE_EN_PASSANT;
+    return (m & 0xF000) == MOVE_EN_PASSANT;
 }
 
 inline bool MoveUtils::isPromotion(Move m) {
@@ -1,4 +1,5 @@
 #include "movegen.h"
+#include "utils.h"
 
 // Direction deltas for each piece type
 static const int KING_DELTAS[] = {-9, -8, -7, -1, 1, 7, 8, 9};
@@ -6,14 +7,15 @@ static const int KNIGHT_DELTAS[] = {-17, -15, -10, -6, 6, 10, 15, 17};
 static const int BISHOP_DELTAS[] = {-9, -7, 7, 9};
 static const int ROOK_DELTAS[] = {-8, -1, 1, 8};
 
-void MoveGenerator::generateMoves(const Board& board, std::vector<Move>& moves) {
+void MoveGenerator::generateMoves(const Board& board, MoveList& moves) {
     moves.clear();
     Color us = board.sideToMove();
     
     // Generate moves for all our pieces
-    for (Square sq = 0; sq < 64; ++sq) {
+    uint64_t ours = board.piecesByColor(us);
+    while (ours) {
+        Square sq = popLsb(ours);
         Piece p = board.pieceAt(sq);
-        if (p == NO_PIECE || colorOf(p) != us) continue;
         
         switch (typeOf(p)) {
             case PAWN:
@@ -38,15 +40,16 @@ void MoveGenerator::generateMoves(const Board& board, std::vector<Move>& moves)
     }
 }
 
-void MoveGenerator::generateCaptures(const Board& board, std::vector<Move>& moves) {
+void MoveGenerator::generateCaptures(const Board& board, MoveList& moves) {
     moves.clear();
     Color us = board.sideToMove();
     Color them = 1 - us;
     
     // Generate captures for all our pieces
-    for (Square sq = 0; sq < 64; ++sq) {
+    uint64_t ours = board.piecesByColor(us);
+    while (ours) {
+        Square sq = popLsb(ours);
         Piece p = board.pieceAt(sq);
-        if (p == NO_PIECE || colorOf(p) != us) continue;
         
         switch (typeOf(p)) {
             case PAWN: {
@@ -167,19 +170,44 @@ void MoveGenerator::generateCaptures(const Board& board, std::vector<Move>& move
     }
 }
 
-void MoveGenerator::generateLegalMoves(const Board& board, std::vector<Move>& moves) {
-    std::vector<Move> pseudoLegal;
-    generateMoves(board, pseudoLegal);
+void MoveGenerator::generateLegalMoves(const Board& board, MoveList& moves) {
+    generateMoves(board, moves);
     
-    moves.clear();
-    for (Move m : pseudoLegal) {
-        if (board.isLegalMove(m)) {
-            moves.push_back(m);
+    // Filter in place, no second list needed
+    for (int i = 0; i < moves.size(); ) {
+        if (board.isLegalMove(moves[i])) {
+            i++;
+        } else {
+            moves.removeAt(i);
+        }
+    }
+}
+
+void MoveGenerator::generateLegalCaptures(const Board& board, MoveList& moves) {
+    generateCaptures(board, moves);
+    
+    for (int i = 0; i < moves.size(); ) {
+        if (board.isLegalMove(moves[i])) {
+            i++;
+        } else {
+            moves.removeAt(i);
+        }
+    }
+}
+
+void MoveGenerator::generateLegalQuiets(const Board& board, MoveList& moves) {
+    generateMoves(board, moves);
+    
+    for (int i = 0; i < moves.size(); ) {
+        if (!MoveUtils::isCapture(moves[i]) && board.isLegalMove(moves[i])) {
+            i++;
+        } else {
+            moves.removeAt(i);
         }
     }
 }
 
-void MoveGenerator::generatePawnMoves(const Board& board, Square from, std::vector<Move>& moves) {
+void MoveGenerator::generatePawnMoves(const Board& board, Square from, MoveList& moves) {
     Color us = board.sideToMove();
     int direction = (us == WHITE) ? 8 : -8;
     int startRank = (us == WHITE) ? 1 : 6;
@@ -239,7 +267,7 @@ void MoveGenerator::generatePawnMoves(const Board& board, Square from, std::vect
     }
 }
 
-void MoveGenerator::generateKnightMoves(const Board& board, Square from, std::vector<Move>& moves) {
+void MoveGenerator::generateKnightMoves(const Board& board, Square from, MoveList& moves) {
     for (int delta : KNIGHT_DELTAS) {
         Square to = from + delta;
         if (to < 0 || to >= 64) continue;
@@ -258,20 +286,20 @@ void MoveGenerator::generateKnightMoves(const Board& board, Square from, std::ve
     }
 }
 
-void MoveGenerator::generateBishopMoves(const Board& board, Square from, std::vector<Move>& moves) {
+void MoveGenerator::generateBishopMoves(const Board& board, Square from, MoveList& moves) {
     generateSlidingMoves(board, from, BISHOP_DELTAS, 4, moves);
 }
 
-void MoveGenerator::generateRookMoves(const Board& board, Square from, std::vector<Move>& moves) {
+void MoveGenerator::generateRookMoves(const Board& board, Square from, MoveList& moves) {
     generateSlidingMoves(board, from, ROOK_DELTAS, 4, moves);
 }
 
-void MoveGenerator::generateQueenMoves(const Board& board, Square from, std::vector<Move>& moves) {
+void MoveGenerator::generateQueenMoves(const Board& board, Square from, MoveList& moves) {
     generateBishopMoves(board, from, moves);
     generateRookMoves(board, from, moves);
 }
 
-void MoveGenerator::generateKingMoves(const Board& board, Square from, std::vector<Move>& moves) {
+void MoveGenerator::generateKingMoves(const Board& board, Square from, MoveList& moves) {
     Color us = board.sideToMove();
     Color them = 1 - us;
     
@@ -339,7 +367,7 @@ void MoveGenerator::generateKingMoves(const Board& board, Square from, std::vect
 
 void MoveGenerator::generateSlidingMoves(const Board& board, Square from, 
                                        const int* deltas, int numDeltas, 
-                                       std::vector<Move>& moves) {
+                                       MoveList& moves) {
     Color us = board.sideToMove();
     
     for (int i = 0; i < numDeltas; ++i) {
@@ -374,6 +402,6 @@ void MoveGenerator::generateSlidingMoves(const Board& board, Square from,
 }
 
 void MoveGenerator::addMove(const Board& board, Square from, Square to, 
-                           std::vector<Move>& moves, uint16_t flags) {
+                           MoveList& moves, uint16_t flags) {
     moves.push_back(MoveUtils::makeMove(from, to, flags));
 }
\ No newline at end of file
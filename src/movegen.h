@@ -4,38 +4,43 @@
 #include "types.h"
 #include "move.h"
 #include "board.h"
-#include <vector>
 
 class MoveGenerator {
 public:
     // Generate all pseudo-legal moves
-    static void generateMoves(const Board& board, std::vector<Move>& moves);
+    static void generateMoves(const Board& board, MoveList& moves);
     
     // Generate only captures
-    static void generateCaptures(const Board& board, std::vector<Move>& moves);
+    static void generateCaptures(const Board& board, MoveList& moves);
     
     // Generate legal moves (checks for legality)
-    static void generateLegalMoves(const Board& board, std::vector<Move>& moves);
+    static void generateLegalMoves(const Board& board, MoveList& moves);
+    
+    // Generate legal captures
+    static void generateLegalCaptures(const Board& board, MoveList& moves);
+    
+    // Generate legal non-captures
+    static void generateLegalQuiets(const Board& board, MoveList& moves);
     
 private:
     // Piece-specific move generators
-    static void generatePawnMoves(const Board& board, Square from, std::vector<Move>& moves);
-    static void generateKnightMoves(const Board& board, Square from, std::vector<Move>& moves);
-    static void generateBishopMoves(const Board& board, Square from, std::vector<Move>& moves);
-    static void generateRookMoves(const Board& board, Square from, std::vector<Move>& moves);
-    static void generateQueenMoves(const Board& board, Square from, std::vector<Move>& moves);
-    static void generateKingMoves(const Board& board, Square from, std::vector<Move>& moves);
+    static void generatePawnMoves(const Board& board, Square from, MoveList& moves);
+    static void generateKnightMoves(const Board& board, Square from, MoveList& moves);
+    static void generateBishopMoves(const Board& board, Square from, MoveList& moves);
+    static void generateRookMoves(const Board& board, Square from, MoveList& moves);
+    static void generateQueenMoves(const Board& board, Square from, MoveList& moves);
+    static void generateKingMoves(const Board& board, Square from, MoveList& moves);
     
     // Helper methods
     static void generateSlidingMoves(const Board& board, Square from, 
                                    const int* deltas, int numDeltas, 
-                                   std::vector<Move>& moves);
+                                   MoveList& moves);
     static void addMove(const Board& board, Square from, Square to, 
-                       std::vector<Move>& moves, uint16_t flags = MOVE_NORMAL);
+                       MoveList& moves, uint16_t flags = MOVE_NORMAL);
     static void addPawnMove(const Board& board, Square from, Square to, 
-                           std::vector<Move>& moves);
+                           MoveList& moves);
     static void addPawnCapture(const Board& board, Square from, Square to, 
-                              std::vector<Move>& moves);
+                              MoveList& moves);
 };
 
 #endif // MOVEGEN_H
\ No newline at end of file
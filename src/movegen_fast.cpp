@@ -1,237 +1,263 @@
 #include "movegen_fast.h"
+#include "utils.h"
 
-void FastMoveGenerator::generateMoves(const Board& board, std::vector<Move>& moves) {
-    moves.clear();
-    moves.reserve(256); // Reserve space to avoid reallocations
-    
-    Color us = board.sideToMove();
-    
-    // Generate moves for each piece type using piece lists (NO 64-square scan!)
-    // Pawns
-    for (Square sq : board.getPieceList(makePiece(us, PAWN))) {
-        generatePawnMoves(board, sq, moves);
-    }
-    
-    // Knights  
-    for (Square sq : board.getPieceList(makePiece(us, KNIGHT))) {
-        generateKnightMoves(board, sq, moves);
-    }
-    
-    // Bishops
-    for (Square sq : board.getPieceList(makePiece(us, BISHOP))) {
-        generateBishopMoves(board, sq, moves);
-    }
-    
-    // Rooks
-    for (Square sq : board.getPieceList(makePiece(us, ROOK))) {
-        generateRookMoves(board, sq, moves);
-    }
-    
-    // Queens
-    for (Square sq : board.getPieceList(makePiece(us, QUEEN))) {
-        generateQueenMoves(board, sq, moves);
-    }
-    
-    // King
-    for (Square sq : board.getPieceList(makePiece(us, KING))) {
-        generateKingMoves(board, sq, moves);
+// Rank masks used by pawn generation
+constexpr uint64_t RANK_2_BB = 0xFFULL << 8;
+constexpr uint64_t RANK_3_BB = 0xFFULL << 16;
+constexpr uint64_t RANK_6_BB = 0xFFULL << 40;
+constexpr uint64_t RANK_7_BB = 0xFFULL << 48;
+
+// Shift a pawn set one rank forward from the point of view of color C
+template <Color C>
+static constexpr uint64_t pawnPush(uint64_t b) {
+    return C == WHITE ? b << 8 : b >> 8;
+}
+
+// A pinned piece may only move along the line through its king
+static inline bool pinAllows(uint64_t pinned, Square ksq, Square from, Square to) {
+    return !(pinned & Attacks::squareBB(from)) || (Attacks::line(ksq, from) & Attacks::squareBB(to));
+}
+
+void FastMoveGenerator::generateMoves(const Board& board, MoveList& moves) {
+    generateForSideToMove<ALL_MOVES, false>(board, moves);
+}
+
+void FastMoveGenerator::generateCaptures(const Board& board, MoveList& moves) {
+    generateForSideToMove<CAPTURES, false>(board, moves);
+}
+
+void FastMoveGenerator::generateLegalMoves(const Board& board, MoveList& moves) {
+    generateForSideToMove<ALL_MOVES, true>(board, moves);
+}
+
+void FastMoveGenerator::generateLegalCaptures(const Board& board, MoveList& moves) {
+    generateForSideToMove<CAPTURES, true>(board, moves);
+}
+
+void FastMoveGenerator::generateLegalQuiets(const Board& board, MoveList& moves) {
+    generateForSideToMove<QUIETS, true>(board, moves);
+}
+
+template <GenType Type, bool Legal>
+void FastMoveGenerator::generateForSideToMove(const Board& board, MoveList& moves) {
+    uint64_t checkers = Legal ? board.checkers() : 0;
+    bool white = board.sideToMove() == WHITE;
+
+    if constexpr (Type == ALL_MOVES && Legal) {
+        if (checkers) {
+            if (white) generate<WHITE, EVASIONS, true>(board, checkers, moves);
+            else generate<BLACK, EVASIONS, true>(board, checkers, moves);
+            return;
+        }
     }
-    
-    // Castling
-    generateCastling(board, moves);
+    if (white) generate<WHITE, Type, Legal>(board, checkers, moves);
+    else generate<BLACK, Type, Legal>(board, checkers, moves);
 }
 
-void FastMoveGenerator::generateCaptures(const Board& board, std::vector<Move>& moves) {
+template <Color Us, GenType Type, bool Legal>
+void FastMoveGenerator::generate(const Board& board, uint64_t checkers, MoveList& moves) {
+    static_assert(Type != EVASIONS || Legal, "evasions are only generated legal");
+    constexpr Color Them = 1 - Us;
     moves.clear();
-    moves.reserve(64);
-    
-    Color us = board.sideToMove();
-    
-    // Generate captures for each piece type
-    for (Square sq : board.getPieceList(makePiece(us, PAWN))) {
-        uint64_t attacks = Attacks::getPawnAttacks(sq, us);
-        addCapturesFromBitboard(board, sq, attacks, moves);
-        
-        // En passant
-        Square ep = board.enPassantSquare();
-        if (ep != -1 && Attacks::testBit(attacks, ep)) {
-            moves.push_back(MoveUtils::makeMove(sq, ep, MOVE_EN_PASSANT));
+
+    uint64_t kingTargets = Type == CAPTURES ? board.piecesByColor(Them)
+                         : Type == QUIETS   ? ~board.occupied()
+                                            : ~board.piecesByColor(Us);
+    uint64_t targets = kingTargets;
+    uint64_t pinned = 0;
+
+    if constexpr (Legal) {
+        pinned = board.pinnedPieces(Us);
+
+        // In double check only the king can move
+        if (checkers & (checkers - 1)) {
+            generateKingMoves<Us, true>(board, kingTargets, moves);
+            return;
+        }
+
+        // In single check other pieces must capture the checker or block
+        if (checkers) {
+            targets &= Attacks::between(board.kingSquare(Us), lsb(checkers)) | checkers;
         }
     }
-    
-    for (Square sq : board.getPieceList(makePiece(us, KNIGHT))) {
-        uint64_t attacks = Attacks::getKnightAttacks(sq);
-        addCapturesFromBitboard(board, sq, attacks, moves);
-    }
-    
-    for (Square sq : board.getPieceList(makePiece(us, BISHOP))) {
-        uint64_t occupancy = getOccupancy(board);
-        uint64_t attacks = Attacks::getBishopAttacks(sq, occupancy);
-        addCapturesFromBitboard(board, sq, attacks, moves);
-    }
-    
-    for (Square sq : board.getPieceList(makePiece(us, ROOK))) {
-        uint64_t occupancy = getOccupancy(board);
-        uint64_t attacks = Attacks::getRookAttacks(sq, occupancy);
-        addCapturesFromBitboard(board, sq, attacks, moves);
-    }
-    
-    for (Square sq : board.getPieceList(makePiece(us, QUEEN))) {
-        uint64_t occupancy = getOccupancy(board);
-        uint64_t attacks = Attacks::getQueenAttacks(sq, occupancy);
-        addCapturesFromBitboard(board, sq, attacks, moves);
-    }
-    
-    for (Square sq : board.getPieceList(makePiece(us, KING))) {
-        uint64_t attacks = Attacks::getKingAttacks(sq);
-        addCapturesFromBitboard(board, sq, attacks, moves);
+
+    // Generate moves for each piece type straight from the bitboards
+    generatePawnMoves<Us, Type, Legal>(board, targets, pinned, moves);
+    generatePieceMoves<Us, KNIGHT>(board, targets, pinned, moves);
+    generatePieceMoves<Us, BISHOP>(board, targets, pinned, moves);
+    generatePieceMoves<Us, ROOK>(board, targets, pinned, moves);
+    generatePieceMoves<Us, QUEEN>(board, targets, pinned, moves);
+    generateKingMoves<Us, Legal>(board, kingTargets, moves);
+
+    // Castling
+    if constexpr (Type == QUIETS || Type == ALL_MOVES) {
+        if (!checkers) {
+            generateCastling<Us>(board, moves);
+        }
     }
 }
 
-void FastMoveGenerator::generateLegalMoves(const Board& board, std::vector<Move>& moves) {
-    generateMoves(board, moves);
-    
-    // Filter out illegal moves (simplified - full implementation would be more complex)
-    moves.erase(std::remove_if(moves.begin(), moves.end(),
-        [&board](Move m) { return !board.isLegalMove(m); }), moves.end());
-}
+template <Color Us, GenType Type, bool Legal>
+inline void FastMoveGenerator::generatePawnMoves(const Board& board, uint64_t targets, uint64_t pinned,
+                                                 MoveList& moves) {
+    constexpr Color Them = 1 - Us;
+    constexpr int Up = Us == WHITE ? 8 : -8;
+    constexpr uint64_t PromoRank = Us == WHITE ? RANK_7_BB : RANK_2_BB;
+    constexpr uint64_t ThirdRank = Us == WHITE ? RANK_3_BB : RANK_6_BB;
+    Square ksq = board.kingSquare(Us);
 
-inline void FastMoveGenerator::generatePawnMoves(const Board& board, Square from, std::vector<Move>& moves) {
-    Color us = board.sideToMove();
-    int direction = (us == WHITE) ? 8 : -8;
-    int startRank = (us == WHITE) ? 1 : 6;
-    int promoRank = (us == WHITE) ? 6 : 1;
-    
-    // Forward moves
-    Square to = from + direction;
-    if (to >= 0 && to < 64 && board.pieceAt(to) == NO_PIECE) {
-        if (rankOf(from) == promoRank) {
-            // Promotion
-            for (PieceType pt = QUEEN; pt >= KNIGHT; --pt) {
-                Move m = MoveUtils::makePromotion(from, to, pt);
-                moves.push_back(m);
+    uint64_t empty = ~board.occupied();
+    uint64_t theirs = board.piecesByColor(Them);
+    uint64_t pawns = board.pieces(Us, PAWN) & ~PromoRank;
+    uint64_t promoPawns = board.pieces(Us, PAWN) & PromoRank;
+
+    // Single and double pushes, plus non-capturing promotions
+    if constexpr (Type != CAPTURES) {
+        uint64_t push1 = pawnPush<Us>(pawns) & empty;
+        uint64_t push2 = pawnPush<Us>(push1 & ThirdRank) & empty & targets;
+        push1 &= targets;
+
+        while (push1) {
+            Square to = popLsb(push1);
+            if (pinAllows(pinned, ksq, to - Up, to)) {
+                moves.push_back(MoveUtils::makeMove(to - Up, to));
             }
-        } else {
-            moves.push_back(MoveUtils::makeMove(from, to));
-            
-            // Double push from starting rank
-            if (rankOf(from) == startRank) {
-                to = from + 2 * direction;
-                if (to >= 0 && to < 64 && board.pieceAt(to) == NO_PIECE) {
-                    moves.push_back(MoveUtils::makeMove(from, to));
-                }
+        }
+        while (push2) {
+            Square to = popLsb(push2);
+            if (pinAllows(pinned, ksq, to - 2 * Up, to)) {
+                moves.push_back(MoveUtils::makeMove(to - 2 * Up, to));
+            }
+        }
+
+        uint64_t promoPushes = pawnPush<Us>(promoPawns) & empty & targets;
+        while (promoPushes) {
+            Square to = popLsb(promoPushes);
+            if (pinAllows(pinned, ksq, to - Up, to)) {
+                addPromotions(to - Up, to, MOVE_NORMAL, moves);
             }
         }
     }
-    
-    // Captures using precomputed attack table
-    uint64_t attacks = Attacks::getPawnAttacks(from, us);
-    addCapturesFromBitboard(board, from, attacks, moves);
-    
-    // En passant
-    Square ep = board.enPassantSquare();
-    if (ep != -1 && Attacks::testBit(attacks, ep)) {
-        moves.push_back(MoveUtils::makeMove(from, ep, MOVE_EN_PASSANT));
+
+    if constexpr (Type == QUIETS) return;
+
+    // Captures using precomputed attack tables
+    uint64_t captureTargets = theirs & targets;
+    while (pawns) {
+        Square from = popLsb(pawns);
+        uint64_t attacks = Attacks::getPawnAttacks(from, Us) & captureTargets;
+        if (pinned & Attacks::squareBB(from)) {
+            attacks &= Attacks::line(ksq, from);
+        }
+        addMovesFromBitboard(from, attacks, moves, MOVE_CAPTURE);
+    }
+    while (promoPawns) {
+        Square from = popLsb(promoPawns);
+        uint64_t attacks = Attacks::getPawnAttacks(from, Us) & captureTargets;
+        if (pinned & Attacks::squareBB(from)) {
+            attacks &= Attacks::line(ksq, from);
+        }
+        while (attacks) {
+            addPromotions(from, popLsb(attacks), MOVE_CAPTURE, moves);
+        }
     }
-}
 
-inline void FastMoveGenerator::generateKnightMoves(const Board& board, Square from, std::vector<Move>& moves) {
-    uint64_t attacks = Attacks::getKnightAttacks(from);
-    
-    // Split into captures and quiet moves
-    addCapturesFromBitboard(board, from, attacks, moves);
-    addMovesFromBitboard(from, attacks & ~getOccupancy(board), moves);
-}
+    // En passant: our pawns standing where an enemy pawn on ep would attack
+    Square ep = board.enPassantSquare();
+    if (ep != -1) {
+        Square captureSquare = ep - Up;
+        uint64_t attackers = Attacks::getPawnAttacks(ep, Them) & board.pieces(Us, PAWN);
+        while (attackers) {
+            Square from = popLsb(attackers);
 
-inline void FastMoveGenerator::generateBishopMoves(const Board& board, Square from, std::vector<Move>& moves) {
-    uint64_t occupancy = getOccupancy(board);
-    uint64_t attacks = Attacks::getBishopAttacks(from, occupancy);
-    
-    addCapturesFromBitboard(board, from, attacks, moves);
-    addMovesFromBitboard(from, attacks & ~occupancy, moves);
+            // Two pawns leave their squares at once, which can expose the king
+            // along the rank, so test the resulting occupancy directly
+            if constexpr (Legal) {
+                uint64_t occ = (board.occupied() ^ Attacks::squareBB(from) ^ Attacks::squareBB(captureSquare))
+                             | Attacks::squareBB(ep);
+                if (board.attackersTo(ksq, occ) & theirs & ~Attacks::squareBB(captureSquare)) {
+                    continue;
+                }
+            }
+            moves.push_back(MoveUtils::makeMove(from, ep, MOVE_EN_PASSANT));
+        }
+    }
 }
 
-inline void FastMoveGenerator::generateRookMoves(const Board& board, Square from, std::vector<Move>& moves) {
-    uint64_t occupancy = getOccupancy(board);
-    uint64_t attacks = Attacks::getRookAttacks(from, occupancy);
-    
-    addCapturesFromBitboard(board, from, attacks, moves);
-    addMovesFromBitboard(from, attacks & ~occupancy, moves);
-}
+template <Color Us, PieceType Pt>
+inline void FastMoveGenerator::generatePieceMoves(const Board& board, uint64_t targets, uint64_t pinned,
+                                                  MoveList& moves) {
+    Square ksq = board.kingSquare(Us);
+    uint64_t occupancy = board.occupied();
+    uint64_t theirs = board.piecesByColor(1 - Us);
+    uint64_t pieces = board.pieces(Us, Pt);
 
-inline void FastMoveGenerator::generateQueenMoves(const Board& board, Square from, std::vector<Move>& moves) {
-    uint64_t occupancy = getOccupancy(board);
-    uint64_t attacks = Attacks::getQueenAttacks(from, occupancy);
-    
-    addCapturesFromBitboard(board, from, attacks, moves);
-    addMovesFromBitboard(from, attacks & ~occupancy, moves);
-}
+    while (pieces) {
+        Square from = popLsb(pieces);
+        uint64_t attacks = Attacks::getPieceAttacks(Pt, from, occupancy) & targets;
+        if (pinned & Attacks::squareBB(from)) {
+            attacks &= Attacks::line(ksq, from);
+        }
 
-inline void FastMoveGenerator::generateKingMoves(const Board& board, Square from, std::vector<Move>& moves) {
-    uint64_t attacks = Attacks::getKingAttacks(from);
-    
-    addCapturesFromBitboard(board, from, attacks, moves);
-    addMovesFromBitboard(from, attacks & ~getOccupancy(board), moves);
+        // Split into captures and quiet moves
+        addMovesFromBitboard(from, attacks & theirs, moves, MOVE_CAPTURE);
+        addMovesFromBitboard(from, attacks & ~theirs, moves);
+    }
 }
 
-inline void FastMoveGenerator::generateCastling(const Board& board, std::vector<Move>& moves) {
-    Color us = board.sideToMove();
-    
-    if (us == WHITE) {
-        if ((board.castlingRights() & WHITE_KINGSIDE) && 
-            board.pieceAt(F1) == NO_PIECE && board.pieceAt(G1) == NO_PIECE &&
-            !board.isAttacked(E1, BLACK) && !board.isAttacked(F1, BLACK) && !board.isAttacked(G1, BLACK)) {
-            moves.push_back(MoveUtils::makeMove(E1, G1, MOVE_CASTLE));
-        }
-        if ((board.castlingRights() & WHITE_QUEENSIDE) &&
-            board.pieceAt(D1) == NO_PIECE && board.pieceAt(C1) == NO_PIECE && board.pieceAt(B1) == NO_PIECE &&
-            !board.isAttacked(E1, BLACK) && !board.isAttacked(D1, BLACK) && !board.isAttacked(C1, BLACK)) {
-            moves.push_back(MoveUtils::makeMove(E1, C1, MOVE_CASTLE));
-        }
-    } else {
-        if ((board.castlingRights() & BLACK_KINGSIDE) &&
-            board.pieceAt(F8) == NO_PIECE && board.pieceAt(G8) == NO_PIECE &&
-            !board.isAttacked(E8, WHITE) && !board.isAttacked(F8, WHITE) && !board.isAttacked(G8, WHITE)) {
-            moves.push_back(MoveUtils::makeMove(E8, G8, MOVE_CASTLE));
-        }
-        if ((board.castlingRights() & BLACK_QUEENSIDE) &&
-            board.pieceAt(D8) == NO_PIECE && board.pieceAt(C8) == NO_PIECE && board.pieceAt(B8) == NO_PIECE &&
-            !board.isAttacked(E8, WHITE) && !board.isAttacked(D8, WHITE) && !board.isAttacked(C8, WHITE)) {
-            moves.push_back(MoveUtils::makeMove(E8, C8, MOVE_CASTLE));
+template <Color Us, bool Legal>
+inline void FastMoveGenerator::generateKingMoves(const Board& board, uint64_t targets, MoveList& moves) {
+    Square from = board.kingSquare(Us);
+    uint64_t theirs = board.piecesByColor(1 - Us);
+    uint64_t attacks = Attacks::getKingAttacks(from) & targets;
+
+    if constexpr (Legal) {
+        // Remove the king from the occupancy so sliders see through its old square
+        uint64_t occ = board.occupied() ^ Attacks::squareBB(from);
+        uint64_t safe = 0;
+        while (attacks) {
+            Square to = popLsb(attacks);
+            if (!(board.attackersTo(to, occ) & theirs)) {
+                safe |= Attacks::squareBB(to);
+            }
         }
+        attacks = safe;
     }
+
+    addMovesFromBitboard(from, attacks & theirs, moves, MOVE_CAPTURE);
+    addMovesFromBitboard(from, attacks & ~theirs, moves);
 }
 
-inline uint64_t FastMoveGenerator::getOccupancy(const Board& board) {
-    uint64_t occupancy = 0;
-    for (Square sq = 0; sq < 64; ++sq) {
-        if (board.pieceAt(sq) != NO_PIECE) {
-            occupancy = Attacks::setBit(occupancy, sq);
-        }
+template <Color Us>
+inline void FastMoveGenerator::generateCastling(const Board& board, MoveList& moves) {
+    constexpr Color Them = 1 - Us;
+    constexpr int KingSide = Us == WHITE ? WHITE_KINGSIDE : BLACK_KINGSIDE;
+    constexpr int QueenSide = Us == WHITE ? WHITE_QUEENSIDE : BLACK_QUEENSIDE;
+    constexpr Square King = Us == WHITE ? E1 : E8;
+    uint64_t occupancy = board.occupied();
+
+    if ((board.castlingRights() & KingSide) &&
+        !(occupancy & (Attacks::squareBB(King + 1) | Attacks::squareBB(King + 2))) &&
+        !board.isAttacked(King, Them) && !board.isAttacked(King + 1, Them) && !board.isAttacked(King + 2, Them)) {
+        moves.push_back(MoveUtils::makeMove(King, King + 2, MOVE_CASTLE));
+    }
+    if ((board.castlingRights() & QueenSide) &&
+        !(occupancy & (Attacks::squareBB(King - 1) | Attacks::squareBB(King - 2) | Attacks::squareBB(King - 3))) &&
+        !board.isAttacked(King, Them) && !board.isAttacked(King - 1, Them) && !board.isAttacked(King - 2, Them)) {
+        moves.push_back(MoveUtils::makeMove(King, King - 2, MOVE_CASTLE));
     }
-    return occupancy;
 }
 
-inline void FastMoveGenerator::addMovesFromBitboard(Square from, uint64_t targets, 
-                                                   std::vector<Move>& moves, uint16_t flags) {
+inline void FastMoveGenerator::addMovesFromBitboard(Square from, uint64_t targets,
+                                                   MoveList& moves, uint16_t flags) {
     while (targets) {
-        Square to = __builtin_ctzll(targets); // Find first set bit
-        targets = Attacks::clearBit(targets, to);
-        moves.push_back(MoveUtils::makeMove(from, to, flags));
+        moves.push_back(MoveUtils::makeMove(from, popLsb(targets), flags));
     }
 }
 
-inline void FastMoveGenerator::addCapturesFromBitboard(const Board& board, Square from, 
-                                                      uint64_t targets, std::vector<Move>& moves) {
-    Color them = 1 - board.sideToMove();
-    
-    while (targets) {
-        Square to = __builtin_ctzll(targets);
-        targets = Attacks::clearBit(targets, to);
-        
-        Piece captured = board.pieceAt(to);
-        if (captured != NO_PIECE && colorOf(captured) == them) {
-            moves.push_back(MoveUtils::makeMove(from, to, MOVE_CAPTURE));
-        }
+inline void FastMoveGenerator::addPromotions(Square from, Square to, uint16_t flags,
+                                             MoveList& moves) {
+    for (PieceType pt = QUEEN; pt >= KNIGHT; --pt) {
+        moves.push_back(MoveUtils::makePromotion(from, to, pt) | flags);
     }
-}
\ No newline at end of file
+}
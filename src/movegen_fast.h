@@ -5,38 +5,76 @@
 #include "move.h"
 #include "board.h"
 #include "attacks.h"
-#include <vector>
+#include "movegen.h"
+
+// Which moves a generator call produces. CAPTURES and QUIETS partition the
+// move list: captures include capture-promotions and en passant, quiets
+// include pushes, quiet promotions and castling. EVASIONS are the legal
+// moves out of check, all moves when in check.
+enum GenType { CAPTURES, QUIETS, EVASIONS, ALL_MOVES };
 
 class FastMoveGenerator {
 public:
-    // Generate all pseudo-legal moves using piece lists and precomputed tables
-    static void generateMoves(const Board& board, std::vector<Move>& moves);
+    // Generate all pseudo-legal moves using piece bitboards and precomputed tables
+    static void generateMoves(const Board& board, MoveList& moves);
+    
+    // Generate only captures (pseudo-legal)
+    static void generateCaptures(const Board& board, MoveList& moves);
     
-    // Generate only captures for quiescence search
-    static void generateCaptures(const Board& board, std::vector<Move>& moves);
+    // Generate legal moves directly from check and pin masks
+    static void generateLegalMoves(const Board& board, MoveList& moves);
     
-    // Generate legal moves (checks for legality)
-    static void generateLegalMoves(const Board& board, std::vector<Move>& moves);
+    // Generate legal captures for quiescence search
+    static void generateLegalCaptures(const Board& board, MoveList& moves);
     
+    // Generate legal non-captures, the quiet stage of the move picker
+    static void generateLegalQuiets(const Board& board, MoveList& moves);
+
 private:
-    // Fast piece-specific generators using precomputed tables
-    static inline void generatePawnMoves(const Board& board, Square from, std::vector<Move>& moves);
-    static inline void generateKnightMoves(const Board& board, Square from, std::vector<Move>& moves);
-    static inline void generateBishopMoves(const Board& board, Square from, std::vector<Move>& moves);
-    static inline void generateRookMoves(const Board& board, Square from, std::vector<Move>& moves);
-    static inline void generateQueenMoves(const Board& board, Square from, std::vector<Move>& moves);
-    static inline void generateKingMoves(const Board& board, Square from, std::vector<Move>& moves);
+    // Shared generator, specialized for the side to move so that pawn
+    // directions, ranks and castling squares are constants. Legal restricts
+    // moves with the checkers and pinned pieces; the checkers are passed in
+    // (0 when not legal).
+    template <Color Us, GenType Type, bool Legal>
+    static void generate(const Board& board, uint64_t checkers, MoveList& moves);
+    
+    // Dispatch on the side to move, and to EVASIONS when a legal ALL_MOVES
+    // call finds the king in check
+    template <GenType Type, bool Legal>
+    static void generateForSideToMove(const Board& board, MoveList& moves);
+    
+    // Pawn moves are generated set-wise by GenType
+    template <Color Us, GenType Type, bool Legal>
+    static inline void generatePawnMoves(const Board& board, uint64_t targets, uint64_t pinned,
+                                         MoveList& moves);
+    
+    // Knight, bishop, rook and queen moves onto the target squares
+    template <Color Us, PieceType Pt>
+    static inline void generatePieceMoves(const Board& board, uint64_t targets, uint64_t pinned,
+                                          MoveList& moves);
+    
+    // King moves; in legal mode only to squares not attacked once the king has moved
+    template <Color Us, bool Legal>
+    static inline void generateKingMoves(const Board& board, uint64_t targets, MoveList& moves);
     
     // Fast castling generator
-    static inline void generateCastling(const Board& board, std::vector<Move>& moves);
+    template <Color Us>
+    static inline void generateCastling(const Board& board, MoveList& moves);
     
     // Helper methods for bitboard operations
-    static inline uint64_t getOccupancy(const Board& board);
     static inline void addMovesFromBitboard(Square from, uint64_t targets, 
-                                          std::vector<Move>& moves, 
+                                          MoveList& moves, 
                                           uint16_t flags = MOVE_NORMAL);
-    static inline void addCapturesFromBitboard(const Board& board, Square from, 
-                                             uint64_t targets, std::vector<Move>& moves);
+    static inline void addPromotions(Square from, Square to, uint16_t flags,
+                                     MoveList& moves);
 };
 
-#endif // MOVEGEN_FAST_H
\ No newline at end of file
+// Generator used by search, perft and UCI move parsing. Build with
+// MOVEGEN=reference to fall back to the original delta-walking generator.
+#ifdef REFERENCE_MOVEGEN
+using DefaultMoveGenerator = MoveGenerator;
+#else
+using DefaultMoveGenerator = FastMoveGenerator;
+#endif
+
+#endif // MOVEGEN_FAST_H
@@ -0,0 +1,142 @@
+#include "movepick.h"
+#include "movegen_fast.h"
+#include "stats.h"
+
+// Piece values used for capture ordering, indexed by piece type
+static const Score PICK_VALUES[] = {100, 320, 330, 500, 900, 10000};
+
+// Quiet queen promotions are tried before every other quiet move
+constexpr Score QUEEN_PROMOTION_BONUS = 1 << 28;
+
+MovePicker::MovePicker(const Board& board, Move ttMove, const Move killers[2], Move counterMove,
+                       const ButterflyHistory& history, const PieceToHistory* const continuation[2])
+    : board(board), history(history), continuation{continuation[0], continuation[1]},
+      ttMove(ttMove), killers{killers[0], killers[1]}, counterMove(counterMove) {
+    // A TT move from a hash collision may not even be pseudo-legal here
+    bool validTT = ttMove && board.isPseudoLegal(ttMove) && board.isLegal(ttMove);
+    stage = validTT ? TT_MOVE : GEN_CAPTURES;
+    if (!validTT) this->ttMove = 0;
+    
+    // The countermove is only tried separately when it is not a killer
+    if (counterMove == killers[0] || counterMove == killers[1]) this->counterMove = 0;
+}
+
+Move MovePicker::next() {
+    switch (stage) {
+        case TT_MOVE:
+            stage = GEN_CAPTURES;
+            return ttMove;
+        
+        case GEN_CAPTURES:
+            {
+                STATS_TIMER(MOVEGEN_CALLS);
+                DefaultMoveGenerator::generateLegalCaptures(board, captures);
+            }
+            for (int i = 0; i < captures.size(); ++i) {
+                captures.score(i) = mvvLva(board, captures[i]);
+            }
+            stage = GOOD_CAPTURES;
+            [[fallthrough]];
+        
+        case GOOD_CAPTURES:
+            while (cur < captures.size()) {
+                captures.pickBest(cur);
+                Move m = captures[cur++];
+                if (m == ttMove) continue;
+                if (isBadCapture(m)) {
+                    captures[endBad++] = m;
+                    continue;
+                }
+                return m;
+            }
+            stage = KILLER_1;
+            [[fallthrough]];
+        
+        case KILLER_1:
+            stage = KILLER_2;
+            if (!skipQuietMoves && validKiller(killers[0])) return killers[0];
+            [[fallthrough]];
+        
+        case KILLER_2:
+            stage = COUNTER_MOVE;
+            if (!skipQuietMoves && killers[1] != killers[0] && validKiller(killers[1])) return killers[1];
+            [[fallthrough]];
+        
+        case COUNTER_MOVE:
+            stage = GEN_QUIETS;
+            if (!skipQuietMoves && validKiller(counterMove)) return counterMove;
+            [[fallthrough]];
+        
+        case GEN_QUIETS:
+            if (!skipQuietMoves) {
+                {
+                    STATS_TIMER(MOVEGEN_CALLS);
+                    DefaultMoveGenerator::generateLegalQuiets(board, quiets);
+                }
+                Color us = board.sideToMove();
+                for (int i = 0; i < quiets.size(); ++i) {
+                    Move m = quiets[i];
+                    Piece piece = board.pieceAt(MoveUtils::from(m));
+                    Square to = MoveUtils::to(m);
+                    quiets.score(i) = history.get(us, m);
+                    for (const PieceToHistory* cont : continuation) {
+                        if (cont) quiets.score(i) += (*cont)[piece][to];
+                    }
+                    if (MoveUtils::promotionType(m) == QUEEN) {
+                        quiets.score(i) += QUEEN_PROMOTION_BONUS;
+                    }
+                }
+                quiets.sortByScore();
+            }
+            cur = 0;
+            stage = QUIETS;
+            [[fallthrough]];
+        
+        case QUIETS:
+            while (!skipQuietMoves && cur < quiets.size()) {
+                Move m = quiets[cur++];
+                if (m == ttMove || isRefutation(m)) continue;
+                return m;
+            }
+            cur = 0;
+            stage = BAD_CAPTURES;
+            [[fallthrough]];
+        
+        case BAD_CAPTURES:
+            if (cur < endBad) {
+                return captures[cur++];
+            }
+            stage = DONE;
+            [[fallthrough]];
+        
+        case DONE:
+        default:
+            return 0;
+    }
+}
+
+Score MovePicker::mvvLva(const Board& board, Move m) {
+    if (!MoveUtils::isCapture(m)) return 0;
+    
+    Piece attacker = board.pieceAt(MoveUtils::from(m));
+    Piece victim = board.pieceAt(MoveUtils::to(m));
+    
+    if (victim == NO_PIECE) {
+        // En passant
+        victim = makePiece(1 - board.sideToMove(), PAWN);
+    }
+    
+    // Victim value - attacker value
+    return PICK_VALUES[typeOf(victim)] - PICK_VALUES[typeOf(attacker)] / 10;
+}
+
+// Captures that lose material in the exchange are tried after the quiets
+bool MovePicker::isBadCapture(Move m) const {
+    return !board.see(m, 0);
+}
+
+// Killers and countermoves come from other nodes, so they must be
+// re-validated here
+bool MovePicker::validKiller(Move m) const {
+    return m && m != ttMove && !MoveUtils::isCapture(m) && board.isPseudoLegal(m) && board.isLegal(m);
+}
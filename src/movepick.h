@@ -0,0 +1,65 @@
+#ifndef MOVEPICK_H
+#define MOVEPICK_H
+
+#include "types.h"
+#include "move.h"
+#include "board.h"
+#include "history.h"
+
+// Staged move picker for the main search. Moves are handed out one at a time
+// and each stage only does its work once the previous one is exhausted, so a
+// cutoff on the TT move skips move generation entirely and a cutoff on a
+// capture skips generating and scoring the quiets.
+//
+// Quiets are ordered by butterfly history plus the continuation history of
+// the moves one and two plies back (either may be null).
+class MovePicker {
+public:
+    MovePicker(const Board& board, Move ttMove, const Move killers[2], Move counterMove,
+               const ButterflyHistory& history, const PieceToHistory* const continuation[2]);
+    
+    // Next legal move in order, or 0 once all moves have been returned
+    Move next();
+    
+    // Drop the killers and quiets not yet returned (late move pruning)
+    void skipQuiets() { skipQuietMoves = true; }
+    
+    // Most valuable victim, least valuable attacker capture score
+    static Score mvvLva(const Board& board, Move m);
+
+private:
+    enum Stage {
+        TT_MOVE,
+        GEN_CAPTURES,
+        GOOD_CAPTURES,
+        KILLER_1,
+        KILLER_2,
+        COUNTER_MOVE,
+        GEN_QUIETS,
+        QUIETS,
+        BAD_CAPTURES,
+        DONE
+    };
+    
+    const Board& board;
+    const ButterflyHistory& history;
+    const PieceToHistory* continuation[2];
+    Move ttMove;
+    Move killers[2];
+    Move counterMove;
+    int stage;
+    
+    // Good captures are picked from [cur, size); captures deferred as bad
+    // are moved down to [0, endBad) and replayed after the quiets
+    MoveList captures;
+    MoveList quiets;
+    int cur = 0;
+    int endBad = 0;
+    bool skipQuietMoves = false;
+    
+    bool isBadCapture(Move m) const;
+    bool isRefutation(Move m) const { return m == killers[0] || m == killers[1] || m == counterMove; }
+    bool validKiller(Move m) const;
+};
+
+#endif // MOVEPICK_H
@@ -0,0 +1,377 @@
+#include "nnue.h"
+#include "board.h"
+#include "utils.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Kernel selection follows the target flags; build with SIMD=scalar for the
+// portable fallback
+#if defined(NNUE_NO_SIMD)
+#define NNUE_SCALAR
+#elif defined(__AVX512BW__) && defined(__AVX512VNNI__)
+#define NNUE_AVX512
+#include <immintrin.h>
+#elif defined(__AVX2__)
+#define NNUE_AVX2
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define NNUE_NEON
+#include <arm_neon.h>
+#else
+#define NNUE_SCALAR
+#endif
+
+namespace NNUE {
+
+// Parameter blocks, pointing into the mapped or caller-provided file
+struct Network {
+    const int16_t* ftBiases;
+    const int16_t* ftWeights;
+    const int32_t* l2Biases;
+    const int8_t* l2Weights;
+    int32_t outBias;
+    const int8_t* outWeights;
+};
+
+static Network net;
+static bool loaded = false;
+static void* mapping = nullptr;
+static size_t mappingSize = 0;
+
+static constexpr size_t pad64(size_t bytes) {
+    return (bytes + 63) & ~size_t(63);
+}
+
+size_t networkBytes() {
+    return HEADER_BYTES
+         + pad64(L1 * sizeof(int16_t))
+         + pad64(size_t(FEATURES) * L1 * sizeof(int16_t))
+         + pad64(L2 * sizeof(int32_t))
+         + pad64(L2 * 2 * L1)
+         + pad64(sizeof(int32_t))
+         + pad64(L2);
+}
+
+// Header: magic, version, then the layer sizes as uint32
+struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t features;
+    uint32_t l1;
+    uint32_t l2;
+};
+
+void writeHeader(void* buffer) {
+    Header header = {{MAGIC[0], MAGIC[1], MAGIC[2], MAGIC[3]}, VERSION, FEATURES, L1, L2};
+    std::memset(buffer, 0, HEADER_BYTES);
+    std::memcpy(buffer, &header, sizeof(header));
+}
+
+// ---------------------------------------------------------------------------
+// SIMD kernels
+// ---------------------------------------------------------------------------
+
+#if defined(NNUE_AVX512)
+using Vec = __m512i;
+constexpr int LANES = 32; // int16 per register
+static inline Vec vload(const int16_t* p) { return _mm512_loadu_si512(p); }
+static inline void vstore(int16_t* p, Vec v) { _mm512_storeu_si512(p, v); }
+static inline Vec vadd(Vec a, Vec b) { return _mm512_add_epi16(a, b); }
+static inline Vec vsub(Vec a, Vec b) { return _mm512_sub_epi16(a, b); }
+#elif defined(NNUE_AVX2)
+using Vec = __m256i;
+constexpr int LANES = 16;
+static inline Vec vload(const int16_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+static inline void vstore(int16_t* p, Vec v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+static inline Vec vadd(Vec a, Vec b) { return _mm256_add_epi16(a, b); }
+static inline Vec vsub(Vec a, Vec b) { return _mm256_sub_epi16(a, b); }
+#elif defined(NNUE_NEON)
+using Vec = int16x8_t;
+constexpr int LANES = 8;
+static inline Vec vload(const int16_t* p) { return vld1q_s16(p); }
+static inline void vstore(int16_t* p, Vec v) { vst1q_s16(p, v); }
+static inline Vec vadd(Vec a, Vec b) { return vaddq_s16(a, b); }
+static inline Vec vsub(Vec a, Vec b) { return vsubq_s16(a, b); }
+#else
+using Vec = int16_t;
+constexpr int LANES = 1;
+static inline Vec vload(const int16_t* p) { return *p; }
+static inline void vstore(int16_t* p, Vec v) { *p = v; }
+static inline Vec vadd(Vec a, Vec b) { return int16_t(a + b); }
+static inline Vec vsub(Vec a, Vec b) { return int16_t(a - b); }
+#endif
+
+static_assert(L1 % LANES == 0, "L1 must be a multiple of the register width");
+
+// dst = src + sum of added rows - sum of removed rows, in one pass so each
+// accumulator chunk stays in a register
+static void applyFeatures(const int16_t* src, int16_t* dst,
+                          const int* added, int addedCount,
+                          const int* removed, int removedCount) {
+    for (int i = 0; i < L1; i += LANES) {
+        Vec v = vload(src + i);
+        for (int a = 0; a < addedCount; ++a) {
+            v = vadd(v, vload(net.ftWeights + size_t(added[a]) * L1 + i));
+        }
+        for (int r = 0; r < removedCount; ++r) {
+            v = vsub(v, vload(net.ftWeights + size_t(removed[r]) * L1 + i));
+        }
+        vstore(dst + i, v);
+    }
+}
+
+// Clipped ReLU of one perspective into uint8 [0, 127]
+static void transform(const int16_t* acc, uint8_t* out) {
+#if defined(NNUE_AVX512)
+    const __m512i max = _mm512_set1_epi16(127);
+    const __m512i order = _mm512_setr_epi64(0, 2, 4, 6, 1, 3, 5, 7);
+    for (int i = 0; i < L1; i += 64) {
+        __m512i a = _mm512_min_epi16(_mm512_loadu_si512(acc + i), max);
+        __m512i b = _mm512_min_epi16(_mm512_loadu_si512(acc + i + 32), max);
+        // packus saturates negatives to 0 but interleaves 128-bit lanes
+        __m512i packed = _mm512_permutexvar_epi64(order, _mm512_packus_epi16(a, b));
+        _mm512_storeu_si512(out + i, packed);
+    }
+#elif defined(NNUE_AVX2)
+    const __m256i max = _mm256_set1_epi16(127);
+    for (int i = 0; i < L1; i += 32) {
+        __m256i a = _mm256_min_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + i)), max);
+        __m256i b = _mm256_min_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + i + 16)), max);
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), packed);
+    }
+#elif defined(NNUE_NEON)
+    const int16x8_t max = vdupq_n_s16(127);
+    for (int i = 0; i < L1; i += 16) {
+        uint8x8_t a = vqmovun_s16(vminq_s16(vld1q_s16(acc + i), max));
+        uint8x8_t b = vqmovun_s16(vminq_s16(vld1q_s16(acc + i + 8), max));
+        vst1q_u8(out + i, vcombine_u8(a, b));
+    }
+#else
+    for (int i = 0; i < L1; ++i) {
+        out[i] = uint8_t(std::clamp<int>(acc[i], 0, 127));
+    }
+#endif
+}
+
+// Dot product of uint8 activations with int8 weights; n is a multiple of 64
+static int32_t dot(const uint8_t* in, const int8_t* w, int n) {
+#if defined(NNUE_AVX512)
+    __m512i sum = _mm512_setzero_si512();
+    for (int i = 0; i < n; i += 64) {
+        sum = _mm512_dpbusd_epi32(sum, _mm512_loadu_si512(in + i), _mm512_loadu_si512(w + i));
+    }
+    return _mm512_reduce_add_epi32(sum);
+#elif defined(NNUE_AVX2)
+    // Activations are at most 127, so the pairwise int16 sums cannot saturate
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i sum = _mm256_setzero_si256();
+    for (int i = 0; i < n; i += 32) {
+        __m256i products = _mm256_maddubs_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i)),
+                                                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w + i)));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(products, ones));
+    }
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+    return _mm_cvtsi128_si32(s);
+#elif defined(NNUE_NEON)
+    // Activations fit in int8, so signed multiplies can be used
+    int32x4_t sum = vdupq_n_s32(0);
+    for (int i = 0; i < n; i += 16) {
+        int8x16_t a = vreinterpretq_s8_u8(vld1q_u8(in + i));
+        int8x16_t b = vld1q_s8(w + i);
+        int16x8_t products = vmull_s8(vget_low_s8(a), vget_low_s8(b));
+        products = vmlal_s8(products, vget_high_s8(a), vget_high_s8(b));
+        sum = vpadalq_s16(sum, products);
+    }
+    return vaddvq_s32(sum);
+#else
+    int32_t sum = 0;
+    for (int i = 0; i < n; ++i) {
+        sum += int32_t(in[i]) * w[i];
+    }
+    return sum;
+#endif
+}
+
+const char* simdName() {
+#if defined(NNUE_AVX512)
+    return "AVX-512 VNNI";
+#elif defined(NNUE_AVX2)
+    return "AVX2";
+#elif defined(NNUE_NEON)
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// Features
+// ---------------------------------------------------------------------------
+
+// King bucket by the king's rank from its own side: 1st, 2nd, 3rd, 4th-8th
+static inline int kingBucket(Color perspective, Square ksq) {
+    int rank = rankOf(perspective == WHITE ? ksq : ksq ^ 56);
+    return std::min(rank, KING_BUCKETS - 1);
+}
+
+// Black sees the board flipped vertically with the colours swapped
+static inline int featureIndex(Color perspective, int bucket, Piece p, Square s) {
+    int relative = (colorOf(p) == perspective ? 0 : 6) + typeOf(p);
+    Square oriented = perspective == WHITE ? s : s ^ 56;
+    return (bucket * 12 + relative) * 64 + oriented;
+}
+
+static void refreshPerspective(const Board& board, Accumulator& acc, Color perspective) {
+    int bucket = kingBucket(perspective, board.kingSquare(perspective));
+    int features[32];
+    int count = 0;
+    
+    uint64_t occ = board.occupied();
+    while (occ) {
+        Square s = popLsb(occ);
+        features[count++] = featureIndex(perspective, bucket, board.pieceAt(s), s);
+    }
+    applyFeatures(net.ftBiases, acc.values[perspective], features, count, nullptr, 0);
+}
+
+void refresh(const Board& board, Accumulator& acc) {
+    refreshPerspective(board, acc, WHITE);
+    refreshPerspective(board, acc, BLACK);
+}
+
+void update(const Accumulator& prev, Accumulator& next, const DirtyPiece& dirty, const Board& board) {
+    for (Color perspective : {WHITE, BLACK}) {
+        int bucket = kingBucket(perspective, board.kingSquare(perspective));
+        
+        int added[3], removed[3];
+        int addedCount = 0, removedCount = 0;
+        bool rebucket = false;
+        for (int i = 0; i < dirty.count; ++i) {
+            Piece p = dirty.piece[i];
+            
+            // Every feature depends on our king's bucket, so a king move
+            // into another bucket needs all of them recomputed
+            if (p == makePiece(perspective, KING)
+                && kingBucket(perspective, dirty.from[i]) != bucket) {
+                rebucket = true;
+                break;
+            }
+            if (dirty.from[i] != -1) removed[removedCount++] = featureIndex(perspective, bucket, p, dirty.from[i]);
+            if (dirty.to[i] != -1) added[addedCount++] = featureIndex(perspective, bucket, p, dirty.to[i]);
+        }
+        
+        if (rebucket) {
+            refreshPerspective(board, next, perspective);
+        } else {
+            applyFeatures(prev.values[perspective], next.values[perspective],
+                          added, addedCount, removed, removedCount);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Inference
+// ---------------------------------------------------------------------------
+
+Score evaluate(const Accumulator& acc, Color stm) {
+    alignas(64) uint8_t input[2 * L1];
+    transform(acc.values[stm], input);
+    transform(acc.values[1 - stm], input + L1);
+    
+    int32_t output = net.outBias;
+    for (int o = 0; o < L2; ++o) {
+        int32_t sum = net.l2Biases[o] + dot(input, net.l2Weights + o * 2 * L1, 2 * L1);
+        int32_t hidden = std::clamp(sum >> WEIGHT_SHIFT, 0, 127);
+        output += hidden * net.outWeights[o];
+    }
+    int64_t score = int64_t(output) * OUTPUT_SCALE / (127 << WEIGHT_SHIFT);
+    return Score(std::clamp<int64_t>(score, -MAX_EVAL, MAX_EVAL));
+}
+
+Score evaluate(const Board& board) {
+    Accumulator acc;
+    refresh(board, acc);
+    return evaluate(acc, board.sideToMove());
+}
+
+// ---------------------------------------------------------------------------
+// Loading
+// ---------------------------------------------------------------------------
+
+static void unmap() {
+    if (mapping) {
+        munmap(mapping, mappingSize);
+        mapping = nullptr;
+        mappingSize = 0;
+    }
+}
+
+bool loadFromMemory(const void* data, size_t size) {
+    loaded = false;
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    if (size != networkBytes() || reinterpret_cast<uintptr_t>(bytes) % 64 != 0) return false;
+    
+    Header header;
+    std::memcpy(&header, bytes, sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, 4) != 0 || header.version != VERSION ||
+        header.features != FEATURES || header.l1 != L1 || header.l2 != L2) {
+        return false;
+    }
+    
+    const uint8_t* p = bytes + HEADER_BYTES;
+    net.ftBiases = reinterpret_cast<const int16_t*>(p);
+    p += pad64(L1 * sizeof(int16_t));
+    net.ftWeights = reinterpret_cast<const int16_t*>(p);
+    p += pad64(size_t(FEATURES) * L1 * sizeof(int16_t));
+    net.l2Biases = reinterpret_cast<const int32_t*>(p);
+    p += pad64(L2 * sizeof(int32_t));
+    net.l2Weights = reinterpret_cast<const int8_t*>(p);
+    p += pad64(L2 * 2 * L1);
+    std::memcpy(&net.outBias, p, sizeof(int32_t));
+    p += pad64(sizeof(int32_t));
+    net.outWeights = reinterpret_cast<const int8_t*>(p);
+    
+    loaded = true;
+    return true;
+}
+
+bool load(const std::string& path) {
+    loaded = false;
+    unmap();
+    if (path.empty() || path == "<empty>") return true;
+    
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) != networkBytes()) {
+        close(fd);
+        return false;
+    }
+    
+    // The weights are used in place, straight from the page cache
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+    
+    mapping = data;
+    mappingSize = st.st_size;
+    if (!loadFromMemory(data, mappingSize)) {
+        unmap();
+        return false;
+    }
+    return true;
+}
+
+bool enabled() {
+    return loaded;
+}
+
+}
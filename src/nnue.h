@@ -0,0 +1,93 @@
+#ifndef NNUE_H
+#define NNUE_H
+
+#include "types.h"
+#include <cstddef>
+#include <string>
+
+class Board;
+
+// Efficiently updatable neural network evaluation.
+//
+// Architecture (HalfKA with king buckets):
+//   768 piece-square features per king bucket, seen from each side
+//   -> feature transformer, int16 accumulator of L1 per perspective
+//   -> clipped ReLU [0, 127], side to move first, 2 * L1 uint8
+//   -> affine int8 2 * L1 -> L2, >> 6, clipped ReLU [0, 127]
+//   -> affine int8 L2 -> 1
+//
+// The network is only used once a file has been loaded (EvalFile option);
+// otherwise the hand-written evaluation stays in charge.
+namespace NNUE {
+
+constexpr int KING_BUCKETS = 4;
+constexpr int FEATURES = KING_BUCKETS * 12 * 64;
+constexpr int L1 = 256;
+constexpr int L2 = 32;
+
+// Hidden layer weights are scaled by 64 and activations by 127, so the raw
+// output is OUTPUT_SCALE centipawns per 127 * 64
+constexpr int WEIGHT_SHIFT = 6;
+constexpr int OUTPUT_SCALE = 400;
+
+// Outputs are clamped well below mate scores
+constexpr Score MAX_EVAL = 20000;
+
+// File layout: a 64-byte header followed by each parameter block padded to
+// 64 bytes, little endian, in the order
+//   int16 ftBiases[L1], int16 ftWeights[FEATURES][L1],
+//   int32 l2Biases[L2], int8 l2Weights[L2][2 * L1],
+//   int32 outBias,      int8 outWeights[L2]
+constexpr char MAGIC[4] = {'O', 'P', 'N', 'N'};
+constexpr uint32_t VERSION = 1;
+constexpr size_t HEADER_BYTES = 64;
+size_t networkBytes();
+
+// Write the header for the current architecture, for tools producing networks
+void writeHeader(void* buffer);
+
+// Feature transformer output for both perspectives
+struct alignas(64) Accumulator {
+    int16_t values[2][L1];
+};
+
+// Pieces changed by one move: from == -1 adds a piece, to == -1 removes it
+struct DirtyPiece {
+    int count = 0;
+    Piece piece[3];
+    Square from[3];
+    Square to[3];
+    
+    void add(Piece p, Square f, Square t) {
+        piece[count] = p;
+        from[count] = f;
+        to[count] = t;
+        count++;
+    }
+};
+
+// Memory-map a network file. An empty path or "<empty>" unloads the network.
+bool load(const std::string& path);
+
+// Use a network already in memory; the buffer must outlive its use
+bool loadFromMemory(const void* data, size_t size);
+
+bool enabled();
+
+// Compute both perspectives from scratch
+void refresh(const Board& board, Accumulator& acc);
+
+// Derive the accumulator after a move from the one before it; board is the
+// position after the move
+void update(const Accumulator& prev, Accumulator& next, const DirtyPiece& dirty, const Board& board);
+
+// Score from the side to move's point of view
+Score evaluate(const Accumulator& acc, Color stm);
+Score evaluate(const Board& board);
+
+// Name of the SIMD kernels compiled in
+const char* simdName();
+
+}
+
+#endif // NNUE_H
@@ -0,0 +1,97 @@
+#include "numa.h"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace Numa {
+
+static std::atomic<bool> enabled{false};
+
+#ifdef __linux__
+
+// Numbers in a sysfs list such as "0-3,8-11"
+static std::vector<int> parseList(const std::string& list) {
+    std::vector<int> values;
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos) end = list.size();
+        std::string range = list.substr(pos, end - pos);
+        pos = end + 1;
+        
+        try {
+            size_t dash = range.find('-');
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int v = first; v <= last; ++v) {
+                values.push_back(v);
+            }
+        } catch (...) {
+            // Blank or malformed: nothing on this entry
+        }
+    }
+    return values;
+}
+
+static std::string readLine(const std::string& path) {
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);
+    return line;
+}
+
+// CPU sets of the online nodes that have CPUs
+static const std::vector<cpu_set_t>& nodes() {
+    static const std::vector<cpu_set_t> sets = [] {
+        std::vector<cpu_set_t> result;
+        for (int node : parseList(readLine("/sys/devices/system/node/online"))) {
+            std::string path = "/sys/devices/system/node/node" + std::to_string(node) + "/cpulist";
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (int cpu : parseList(readLine(path))) {
+                if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+            }
+            if (CPU_COUNT(&set) > 0) result.push_back(set);
+        }
+        return result;
+    }();
+    return sets;
+}
+
+int nodeCount() {
+    return std::max<int>(1, nodes().size());
+}
+
+void bindThread(int index) {
+    if (!enabled || nodes().size() < 2) return;
+    const cpu_set_t& set = nodes()[index % nodes().size()];
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set);
+}
+
+#else
+
+int nodeCount() {
+    return 1;
+}
+
+void bindThread(int) {
+}
+
+#endif
+
+void setBinding(bool on) {
+    enabled = on;
+}
+
+bool binding() {
+    return enabled;
+}
+
+}
@@ -0,0 +1,22 @@
+#ifndef NUMA_H
+#define NUMA_H
+
+// Optional binding of search threads to NUMA nodes (Linux, NumaBind
+// option), so a thread keeps running next to the memory it first touched.
+// Nodes and their CPUs are read once from sysfs. With binding off, or on a
+// machine with a single node, binding does nothing.
+namespace Numa {
+
+// Nodes with CPUs; 1 where they cannot be read
+int nodeCount();
+
+void setBinding(bool enabled);
+bool binding();
+
+// Restrict the calling thread to the CPUs of node index % nodeCount(), so
+// consecutive thread indices are spread over the nodes
+void bindThread(int index);
+
+}
+
+#endif // NUMA_H
@@ -0,0 +1,95 @@
+#include "pawns.h"
+#include "attacks.h"
+#include "tune.h"
+#include "utils.h"
+#include <algorithm>
+
+namespace Pawns {
+
+constexpr uint64_t FILE_A_BB = 0x0101010101010101ULL;
+
+static inline uint64_t fileBB(File f) {
+    return FILE_A_BB << f;
+}
+
+static inline uint64_t adjacentFiles(File f) {
+    return (f > 0 ? fileBB(f - 1) : 0) | (f < 7 ? fileBB(f + 1) : 0);
+}
+
+// Ranks strictly in front of s from c's point of view
+static inline uint64_t forwardRanks(Color c, Square s) {
+    Rank r = rankOf(s);
+    if (c == WHITE) return r == 7 ? 0 : ~0ULL << (8 * (r + 1));
+    return (1ULL << (8 * r)) - 1;
+}
+
+static void evaluateSide(const Board& board, Color us, Entry& e) {
+    Color them = 1 - us;
+    uint64_t ours = board.pieces(us, PAWN);
+    uint64_t theirs = board.pieces(them, PAWN);
+    int sign = us == WHITE ? 1 : -1;
+    int up = us == WHITE ? 8 : -8;
+    
+    e.passed[us] = 0;
+    uint64_t pawns = ours;
+    while (pawns) {
+        Square s = popLsb(pawns);
+        File f = fileOf(s);
+        Rank relRank = us == WHITE ? rankOf(s) : 7 - rankOf(s);
+        uint64_t ahead = forwardRanks(us, s);
+        uint64_t neighbours = ours & adjacentFiles(f);
+        
+        if (!(theirs & (fileBB(f) | adjacentFiles(f)) & ahead)) {
+            e.passed[us] |= Attacks::squareBB(s);
+            e.mg += sign * PASSED_MG[relRank];
+            e.eg += sign * PASSED_EG[relRank];
+            TUNE_ADD(passed[relRank], sign);
+        }
+        
+        // Only the rear pawn of a doubled pair is penalised
+        if (ours & fileBB(f) & ahead) {
+            e.mg += sign * DOUBLED[0];
+            e.eg += sign * DOUBLED[1];
+            TUNE_ADD(doubled, sign);
+        }
+        
+        if (!neighbours) {
+            e.mg += sign * ISOLATED[0];
+            e.eg += sign * ISOLATED[1];
+            TUNE_ADD(isolated, sign);
+        } else if (!(neighbours & ~ahead)
+                   && (Attacks::getPawnAttacks(s + up, us) & theirs)) {
+            // Every neighbour is further advanced and the stop square is
+            // controlled by an enemy pawn
+            e.mg += sign * BACKWARD[0];
+            e.eg += sign * BACKWARD[1];
+            TUNE_ADD(backward, sign);
+        }
+    }
+    
+    // Shelter for each king file from the three files around it
+    for (File kf = 0; kf < 8; ++kf) {
+        Score shelter = 0;
+        for (File f = std::max(0, kf - 1); f <= std::min(7, kf + 1); ++f) {
+            uint64_t filePawns = ours & fileBB(f);
+            int index = 3;
+            if (filePawns) {
+                Square nearest = us == WHITE ? lsb(filePawns) : msb(filePawns);
+                Rank relRank = us == WHITE ? rankOf(nearest) : 7 - rankOf(nearest);
+                index = std::min(3, std::max(0, relRank - 1));
+            }
+            shelter += SHELTER[index];
+            TUNE_ADD(shelter[us][kf][index], 1);
+        }
+        e.shelter[us][kf] = int16_t(shelter);
+    }
+}
+
+void compute(const Board& board, Entry& entry) {
+    entry.key = board.getPawnHash();
+    entry.mg = entry.eg = 0;
+    evaluateSide(board, WHITE, entry);
+    evaluateSide(board, BLACK, entry);
+}
+
+}
@@ -0,0 +1,60 @@
+#ifndef PAWNS_H
+#define PAWNS_H
+
+#include "types.h"
+#include "board.h"
+#include <memory>
+
+// Pawn structure evaluation and its per-thread cache. Everything here depends
+// only on the pawns, so it is keyed by Board::getPawnHash().
+namespace Pawns {
+
+// Penalties and bonuses as {middlegame, endgame}
+constexpr Score DOUBLED[2]  = {-10, -20};
+constexpr Score ISOLATED[2] = {-10, -15};
+constexpr Score BACKWARD[2] = { -8, -10};
+
+// Passed pawn bonus by rank from the pawn's own side
+constexpr Score PASSED_MG[8] = {0, 5, 10, 20, 35, 60, 100, 0};
+constexpr Score PASSED_EG[8] = {0, 10, 20, 40, 70, 120, 200, 0};
+
+// Shelter from our rearmost pawn on each file around the king: on the 2nd
+// rank, the 3rd, further up, or none at all
+constexpr Score SHELTER[4] = {0, -10, -20, -30};
+
+struct Entry {
+    uint64_t key;
+    Score mg; // Doubled, isolated, backward and passed pawn terms from
+    Score eg; // White's point of view
+    uint64_t passed[2];
+    
+    // Pawn shield in front of a king on each file, assuming the king is on
+    // its first two ranks (middlegame only)
+    int16_t shelter[2][8];
+};
+
+// Evaluate the pawns of the board into entry
+void compute(const Board& board, Entry& entry);
+
+class Table {
+public:
+    static constexpr size_t SIZE = 8192; // Entries, 512 KB
+    
+    Table() : entries(new Entry[SIZE]()) {}
+    
+    // Entry for the board's pawns, computed on a miss
+    const Entry& probe(const Board& board) {
+        Entry& e = entries[board.getPawnHash() & (SIZE - 1)];
+        if (e.key != board.getPawnHash()) {
+            compute(board, e);
+        }
+        return e;
+    }
+
+private:
+    std::unique_ptr<Entry[]> entries;
+};
+
+}
+
+#endif // PAWNS_H
@@ -0,0 +1,203 @@
+#include "perft.h"
+#include "movegen_fast.h"
+#include "utils.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace Perft {
+
+// Node counts keyed by (position, depth), shared by all perft threads.
+// Slots use the same xor verification as the transposition table, so a
+// slot torn by concurrent writers is simply a miss.
+class HashTable {
+public:
+    explicit HashTable(size_t megabytes) {
+        size_t count = 1;
+        while (count * 2 * sizeof(Slot) <= megabytes * 1024 * 1024) count *= 2;
+        slots.reset(new Slot[count]());
+        mask = count - 1;
+    }
+    
+    bool probe(uint64_t key, int depth, uint64_t& nodes) const {
+        const Slot& slot = slots[index(key, depth)];
+        uint64_t data = slot.data.load(std::memory_order_relaxed);
+        uint64_t check = slot.check.load(std::memory_order_relaxed);
+        if ((check ^ data) != key || int(data & 0xFF) != depth) return false;
+        nodes = data >> 8;
+        return true;
+    }
+    
+    // Always replace; the deep entries near the root are rare enough
+    void store(uint64_t key, int depth, uint64_t nodes) {
+        Slot& slot = slots[index(key, depth)];
+        uint64_t data = nodes << 8 | uint64_t(depth);
+        slot.data.store(data, std::memory_order_relaxed);
+        slot.check.store(key ^ data, std::memory_order_relaxed);
+    }
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> check;
+        std::atomic<uint64_t> data; // Bits 0-7 depth, 8-63 nodes
+    };
+    
+    std::unique_ptr<Slot[]> slots;
+    size_t mask = 0;
+    
+    size_t index(uint64_t key, int depth) const {
+        return size_t(key ^ (uint64_t(depth) * 0x9E3779B97F4A7C15ULL)) & mask;
+    }
+};
+
+static uint64_t search(Board& board, int depth, HashTable* hash) {
+    uint64_t nodes;
+    if (hash && depth > 1 && hash->probe(board.getHash(), depth, nodes)) {
+        return nodes;
+    }
+    
+    MoveList moves;
+    DefaultMoveGenerator::generateLegalMoves(board, moves);
+    if (depth == 1) return moves.size();
+    
+    nodes = 0;
+    for (Move m : moves) {
+        board.makeMove(m);
+        nodes += search(board, depth - 1, hash);
+        board.unmakeMove(m);
+    }
+    
+    if (hash) hash->store(board.getHash(), depth, nodes);
+    return nodes;
+}
+
+uint64_t count(Board& board, int depth) {
+    return depth <= 0 ? 1 : search(board, depth, nullptr);
+}
+
+// Node count below each root move; the moves are handed out to the
+// threads one at a time, each thread working on its own board copy
+static void countRootMoves(const Board& board, int depth, const Options& options,
+                           MoveList& moves, std::vector<uint64_t>& counts) {
+    DefaultMoveGenerator::generateLegalMoves(board, moves);
+    counts.assign(moves.size(), 1);
+    if (depth <= 1) return;
+    
+    std::unique_ptr<HashTable> hash;
+    if (options.hashMB > 0) hash.reset(new HashTable(options.hashMB));
+    
+    std::atomic<int> next{0};
+    auto worker = [&]() {
+        Board local = board;
+        for (int i; (i = next.fetch_add(1)) < moves.size(); ) {
+            local.makeMove(moves[i]);
+            counts[i] = search(local, depth - 1, hash.get());
+            local.unmakeMove(moves[i]);
+        }
+    };
+    
+    int threads = std::max(1, std::min(options.threads, int(moves.size())));
+    std::vector<std::thread> helpers;
+    for (int i = 1; i < threads; ++i) {
+        helpers.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& t : helpers) {
+        t.join();
+    }
+}
+
+uint64_t run(const Board& board, int depth, const Options& options) {
+    if (depth <= 0) return 1;
+    
+    MoveList moves;
+    std::vector<uint64_t> counts;
+    countRootMoves(board, depth, options, moves, counts);
+    uint64_t total = 0;
+    for (uint64_t n : counts) total += n;
+    return total;
+}
+
+uint64_t divide(const Board& board, int depth, const Options& options) {
+    MoveList moves;
+    std::vector<uint64_t> counts;
+    countRootMoves(board, std::max(depth, 1), options, moves, counts);
+    
+    uint64_t total = 0;
+    for (int i = 0; i < moves.size(); ++i) {
+        std::cout << MoveUtils::toString(moves[i]) << ": " << counts[i] << std::endl;
+        total += counts[i];
+    }
+    std::cout << "\nTotal: " << total << std::endl;
+    return total;
+}
+
+static uint64_t nps(uint64_t nodes, int64_t ms) {
+    return ms > 0 ? nodes * 1000 / ms : 0;
+}
+
+int runSuite(const std::string& path, int maxDepth, const Options& options) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cout << "Cannot open " << path << std::endl;
+        return 1;
+    }
+    
+    int positions = 0, failures = 0;
+    uint64_t totalNodes = 0;
+    int64_t totalMs = 0;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::vector<std::string> fields = split(line, ';');
+        if (fields.empty() || fields[0].find('/') == std::string::npos) continue;
+        std::string fen = fields[0].substr(0, fields[0].find_last_not_of(' ') + 1);
+        
+        // Deepest expected count within reach
+        int depth = 0;
+        uint64_t expected = 0;
+        for (size_t i = 1; i < fields.size(); ++i) {
+            std::vector<std::string> tokens = split(fields[i]);
+            if (tokens.size() < 2 || tokens[0].size() < 2 || tokens[0][0] != 'D') continue;
+            int d = std::stoi(tokens[0].substr(1));
+            if (d <= maxDepth && d > depth) {
+                depth = d;
+                expected = std::stoull(tokens[1]);
+            }
+        }
+        if (depth == 0) continue;
+        
+        Board board;
+        board.setFromFEN(fen);
+        auto start = std::chrono::steady_clock::now();
+        uint64_t nodes = run(board, depth, options);
+        int64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        
+        positions++;
+        totalNodes += nodes;
+        totalMs += ms;
+        bool pass = nodes == expected;
+        if (!pass) failures++;
+        
+        std::cout << std::setw(4) << positions << "  depth " << depth
+                  << std::setw(14) << nodes << " nodes" << std::setw(8) << ms << " ms"
+                  << std::setw(12) << nps(nodes, ms) << " nps  "
+                  << (pass ? "✓ PASS" : "✗ FAIL") << "  " << fen;
+        if (!pass) std::cout << " (expected " << expected << ")";
+        std::cout << std::endl;
+    }
+    
+    std::cout << "\nSuite: " << positions << " positions, " << failures << " failures, "
+              << totalNodes << " nodes, " << totalMs << " ms, " << nps(totalNodes, totalMs)
+              << " nps (" << options.threads << " threads, hash " << options.hashMB << " MB)"
+              << std::endl;
+    return failures;
+}
+
+}
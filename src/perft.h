@@ -0,0 +1,33 @@
+#ifndef PERFT_H
+#define PERFT_H
+
+#include "board.h"
+#include <cstddef>
+#include <string>
+
+// Move generation node counts, used as the movegen regression and
+// throughput test by perft_test and the UCI "perft" command
+namespace Perft {
+
+struct Options {
+    int threads = 1;    // Root moves are split across this many threads
+    size_t hashMB = 0;  // Size of the (hash, depth) -> nodes cache, 0 for none
+};
+
+// Single-threaded and uncached; leaf moves are counted without being made
+uint64_t count(Board& board, int depth);
+
+// Threaded and optionally cached
+uint64_t run(const Board& board, int depth, const Options& options = Options());
+
+// Print the node count below each root move and the total
+uint64_t divide(const Board& board, int depth, const Options& options = Options());
+
+// Run an EPD suite with lines like "<fen> ;D1 20 ;D2 400 ...". For each
+// position the deepest listed depth up to maxDepth is checked, printing
+// per-position and aggregate NPS. Returns the number of failures.
+int runSuite(const std::string& path, int maxDepth, const Options& options = Options());
+
+}
+
+#endif // PERFT_H
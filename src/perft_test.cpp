@@ -1,43 +1,242 @@
 #include "board.h"
 #include "movegen.h"
+#include "movegen_fast.h"
+#include "psqt.h"
+#include "nnue.h"
+#include "perft.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <random>
 #include <iostream>
 #include <chrono>
 #include <iomanip>
+#include <sstream>
 
-// Perft function - counts nodes at given depth
-uint64_t perft(Board& board, int depth) {
-    if (depth == 0) return 1;
-    
-    uint64_t nodes = 0;
-    std::vector<Move> moves;
-    MoveGenerator::generateLegalMoves(board, moves);
-    
-    for (Move m : moves) {
-        board.makeMove(m);
-        nodes += perft(board, depth - 1);
-        board.unmakeMove(m);
+// Positions for the generator cross-check: the perft suite plus positions
+// with en passant, promotions, castling through attacks and pinned pieces
+static const char* CROSSCHECK_FENS[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3",
+    "8/8/8/KPp4r/8/8/8/6k1 w - c6 0 2",
+    "r3k2r/8/8/8/8/8/8/R3K2R b KQkq - 0 1",
+    "4k3/1P6/8/8/8/8/6p1/4K3 w - - 0 1",
+    "8/8/8/2k5/3Pp3/8/8/4K3 b - d3 0 1",
+    "3k4/3r4/8/8/8/8/3B4/3K4 w - - 0 1",
+};
+
+// Lists compared by the cross-check
+enum GenList { LEGAL_MOVES, PSEUDO_CAPTURES, LEGAL_CAPTURES, LEGAL_QUIETS };
+
+// Sorted move lists from both generators for the current position
+static bool compareGenerators(const Board& board, GenList list) {
+    static const char* names[] = {"Legal moves", "Captures", "Legal captures", "Legal quiets"};
+    MoveList reference, fast;
+    if (list == PSEUDO_CAPTURES) {
+        MoveGenerator::generateCaptures(board, reference);
+        FastMoveGenerator::generateCaptures(board, fast);
+    } else if (list == LEGAL_CAPTURES) {
+        MoveGenerator::generateLegalCaptures(board, reference);
+        FastMoveGenerator::generateLegalCaptures(board, fast);
+    } else if (list == LEGAL_QUIETS) {
+        MoveGenerator::generateLegalQuiets(board, reference);
+        FastMoveGenerator::generateLegalQuiets(board, fast);
+    } else {
+        MoveGenerator::generateLegalMoves(board, reference);
+        FastMoveGenerator::generateLegalMoves(board, fast);
+    }
+    std::sort(reference.begin(), reference.end());
+    std::sort(fast.begin(), fast.end());
+    if (reference.size() == fast.size() &&
+        std::equal(reference.begin(), reference.end(), fast.begin())) {
+        return true;
     }
     
-    return nodes;
+    std::cout << names[list] << " differ in " << board.toFEN() << std::endl;
+    std::vector<Move> onlyReference, onlyFast;
+    std::set_difference(reference.begin(), reference.end(), fast.begin(), fast.end(),
+                        std::back_inserter(onlyReference));
+    std::set_difference(fast.begin(), fast.end(), reference.begin(), reference.end(),
+                        std::back_inserter(onlyFast));
+    std::cout << "  only in MoveGenerator:";
+    for (Move m : onlyReference) std::cout << " " << MoveUtils::toString(m);
+    std::cout << "\n  only in FastMoveGenerator:";
+    for (Move m : onlyFast) std::cout << " " << MoveUtils::toString(m);
+    std::cout << std::endl;
+    return false;
 }
 
-// Divide function - shows move breakdown
-void divide(Board& board, int depth) {
-    std::vector<Move> moves;
-    MoveGenerator::generateLegalMoves(board, moves);
+// Every 16-bit encoding must pass isPseudoLegal && isLegal exactly when it
+// is in the legal move list (this is how TT and killer moves are validated)
+static bool checkMoveValidation(const Board& board) {
+    MoveList legal;
+    FastMoveGenerator::generateLegalMoves(board, legal);
+    std::sort(legal.begin(), legal.end());
     
-    uint64_t total = 0;
+    for (int i = 0; i < 65536; ++i) {
+        Move m = Move(i);
+        bool accepted = board.isPseudoLegal(m) && board.isLegal(m);
+        if (accepted != std::binary_search(legal.begin(), legal.end(), m)) {
+            std::cout << "Move validation " << (accepted ? "accepts " : "rejects ")
+                      << MoveUtils::toString(m) << " (0x" << std::hex << i << std::dec
+                      << ") in " << board.toFEN() << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// The incremental evaluation terms must match a from-scratch recount
+static bool checkEvalState(const Board& board) {
+    Score material[2] = {0, 0};
+    Score mg = 0, eg = 0;
+    int phase = 0;
+    for (Square s = 0; s < 64; ++s) {
+        Piece p = board.pieceAt(s);
+        if (p == NO_PIECE) continue;
+        material[colorOf(p)] += PSQT::PIECE_VALUES[typeOf(p)];
+        mg += PSQT::mg[p][s];
+        eg += PSQT::eg[p][s];
+        phase += PSQT::PHASE_WEIGHTS[typeOf(p)];
+    }
+    Board fresh;
+    fresh.setFromFEN(board.toFEN());
+    if (material[WHITE] == board.material(WHITE) && material[BLACK] == board.material(BLACK) &&
+        mg == board.psqMidgame() && eg == board.psqEndgame() && phase == board.phase() &&
+        fresh.getPawnHash() == board.getPawnHash()) {
+        return true;
+    }
+    std::cout << "Incremental eval state differs in " << board.toFEN() << std::endl;
+    return false;
+}
+
+// Static exchange results: the move wins exactly `gain` centipawns
+struct SeeCase {
+    const char* fen;
+    const char* move;
+    Score gain;
+};
+
+static const SeeCase SEE_CASES[] = {
+    {"1k1r4/1pp4p/p7/4p3/8/P5P1/1PP4P/2K1R3 w - - 0 1", "e1e5", 100},   // Undefended pawn
+    {"4k3/8/3p4/4p3/8/8/8/4QK2 w - - 0 1", "e1e5", -800},                  // Queen takes a defended pawn
+    {"4k3/4r3/8/4p3/8/8/4R3/4RK2 w - - 0 1", "e2e5", 100},                // X-ray rook behind
+    {"8/8/8/4k3/3p4/8/8/3R2K1 w - - 0 1", "d1d4", -400},                   // King recaptures
+    {"8/8/8/4k3/3p4/2P5/8/3R2K1 w - - 0 1", "d1d4", 100},                  // Square defended, king cannot
+    {"r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1", "e1g1", 0},                   // Castling
+};
+
+static int checkSee() {
+    int failures = 0;
+    for (const SeeCase& c : SEE_CASES) {
+        Board board;
+        board.setFromFEN(c.fen);
+        MoveList moves;
+        FastMoveGenerator::generateLegalMoves(board, moves);
+        Move m = 0;
+        for (Move candidate : moves) {
+            if (MoveUtils::toString(candidate) == c.move) m = candidate;
+        }
+        if (!m || !board.see(m, c.gain) || board.see(m, c.gain + 1)) {
+            std::cout << "SEE of " << c.move << " is not " << c.gain << " in " << c.fen << std::endl;
+            failures++;
+        }
+    }
+    return failures;
+}
+
+// Board::getHash() is the Polyglot book key; the keys after these moves
+// from the start position are those of the Polyglot format description
+struct KeyCase {
+    const char* moves;
+    uint64_t key;
+};
+
+static const KeyCase KEY_CASES[] = {
+    {"", 0x463b96181691fc9cull},
+    {"e2e4", 0x823c9b50fd114196ull},
+    {"e2e4 d7d5", 0x0756b94461c50fb0ull},
+    {"e2e4 d7d5 e4e5", 0x662fafb965db29d4ull},
+    {"e2e4 d7d5 e4e5 f7f5", 0x22a48b5a8e47ff78ull},                 // Capturable en passant
+    {"e2e4 d7d5 e4e5 f7f5 e1e2", 0x652a607ca3f242c1ull},
+    {"e2e4 d7d5 e4e5 f7f5 e1e2 e8f7", 0x00fdd303c946bdd9ull},
+    {"a2a4 b7b5 h2h4 b5b4 c2c4", 0x3c8123ea7b067637ull},
+    {"a2a4 b7b5 h2h4 b5b4 c2c4 b4c3 a1a3", 0x5c3f9b829b279560ull},
+};
+
+static int checkPolyglotKeys() {
+    int failures = 0;
+    for (const KeyCase& c : KEY_CASES) {
+        Board board;
+        std::istringstream moves(c.moves);
+        std::string str;
+        while (moves >> str) {
+            MoveList legal;
+            FastMoveGenerator::generateLegalMoves(board, legal);
+            for (Move m : legal) {
+                if (MoveUtils::toString(m) == str) {
+                    board.makeMove(m);
+                    break;
+                }
+            }
+        }
+        if (board.getHash() != c.key) {
+            std::cout << "Polyglot key of " << board.toFEN() << " is not " << std::hex << c.key << std::dec << std::endl;
+            failures++;
+        }
+    }
+    return failures;
+}
+
+// The incrementally updated NNUE accumulator must match a refresh
+static bool checkAccumulator(const Board& board) {
+    NNUE::Accumulator fresh;
+    NNUE::refresh(board, fresh);
+    if (std::memcmp(&fresh, board.accumulator(), sizeof(fresh)) == 0) return true;
+    std::cout << "NNUE accumulator differs in " << board.toFEN() << std::endl;
+    return false;
+}
+
+// Random weights in the network file layout, enough to exercise the
+// accumulator updates; small feature weights keep the int16 sums exact
+static uint8_t* makeRandomNetwork() {
+    size_t size = NNUE::networkBytes();
+    uint8_t* data = static_cast<uint8_t*>(std::aligned_alloc(64, size));
+    std::mt19937 rng(12345);
+    for (size_t i = NNUE::HEADER_BYTES; i < size; i += 2) {
+        int16_t w = int16_t(int(rng() % 129) - 64);
+        std::memcpy(data + i, &w, 2);
+    }
+    NNUE::writeHeader(data);
+    return data;
+}
+
+// Walk the tree and diff both generators at every node
+static uint64_t crossCheck(Board& board, int depth, int ply, uint64_t& mismatches) {
+    for (GenList list : {LEGAL_MOVES, PSEUDO_CAPTURES, LEGAL_CAPTURES, LEGAL_QUIETS}) {
+        if (!compareGenerators(board, list)) mismatches++;
+    }
+    if (ply <= 1 && !checkMoveValidation(board)) mismatches++;
+    if (!checkEvalState(board)) mismatches++;
+    if (board.accumulator() && !checkAccumulator(board)) mismatches++;
+    if (depth == 0) return 1;
     
+    uint64_t nodes = 1;
+    MoveList moves;
+    MoveGenerator::generateLegalMoves(board, moves);
     for (Move m : moves) {
+        bool check = board.givesCheck(m);
         board.makeMove(m);
-        uint64_t count = perft(board, depth - 1);
+        if (check != (board.checkers() != 0)) mismatches++;
+        nodes += crossCheck(board, depth - 1, ply + 1, mismatches);
         board.unmakeMove(m);
-        
-        std::cout << MoveUtils::toString(m) << ": " << count << std::endl;
-        total += count;
     }
-    
-    std::cout << "\nTotal: " << total << std::endl;
+    return nodes;
 }
 
 // Test a specific position
@@ -51,7 +250,7 @@ void testPosition(const std::string& name, const std::string& fen,
     
     for (int depth = 1; depth <= maxDepth; ++depth) {
         auto start = std::chrono::steady_clock::now();
-        uint64_t result = perft(board, depth);
+        uint64_t result = Perft::count(board, depth);
         auto end = std::chrono::steady_clock::now();
         
         auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
@@ -73,9 +272,26 @@ void testPosition(const std::string& name, const std::string& fen,
         // If test fails, show move breakdown
         if (result != expected[depth-1] && depth == 1) {
             std::cout << "\nMove breakdown:" << std::endl;
-            divide(board, depth);
+            Perft::divide(board, depth);
+        }
+    }
+}
+
+// Pull "--threads N" and "--hash MB" out of the arguments
+static Perft::Options parseOptions(std::vector<std::string>& args) {
+    Perft::Options options;
+    std::vector<std::string> rest;
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (args[i] == "--threads" && i + 1 < args.size()) {
+            options.threads = std::max(1, std::stoi(args[++i]));
+        } else if (args[i] == "--hash" && i + 1 < args.size()) {
+            options.hashMB = std::stoul(args[++i]);
+        } else {
+            rest.push_back(args[i]);
         }
     }
+    args = rest;
+    return options;
 }
 
 int main(int argc, char* argv[]) {
@@ -89,7 +305,7 @@ int main(int argc, char* argv[]) {
         const uint64_t expected[] = {20, 400, 8902, 197281, 4865609};
         testPosition("Starting Position", 
                     "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
-                    4, expected);
+                    5, expected);
     }
     
     // Kiwipete - tests many special moves
@@ -97,7 +313,7 @@ int main(int argc, char* argv[]) {
         const uint64_t expected[] = {48, 2039, 97862, 4085603};
         testPosition("Kiwipete Position", 
                     "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
-                    3, expected);
+                    4, expected);
     }
     
     // Position 3 - Endgame
@@ -105,7 +321,7 @@ int main(int argc, char* argv[]) {
         const uint64_t expected[] = {14, 191, 2812, 43238, 674624};
         testPosition("Endgame Position", 
                     "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
-                    4, expected);
+                    5, expected);
     }
     
     // Position 4 - Promotions
@@ -113,7 +329,7 @@ int main(int argc, char* argv[]) {
         const uint64_t expected[] = {6, 264, 9467, 422333};
         testPosition("Promotion Position", 
                     "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
-                    3, expected);
+                    4, expected);
     }
     
     // Position 5
@@ -121,7 +337,7 @@ int main(int argc, char* argv[]) {
         const uint64_t expected[] = {44, 1486, 62379, 2103487};
         testPosition("Complex Position", 
                     "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
-                    3, expected);
+                    4, expected);
     }
     
     // En passant test
@@ -132,40 +348,58 @@ int main(int argc, char* argv[]) {
                     0, expected);  // Using 0 will skip this for now
     }
     
-    // Interactive mode
-    if (argc > 1) {
-        std::string fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
-        int depth = 1;
-        
-        if (std::string(argv[1]) == "divide" && argc > 2) {
-            depth = std::stoi(argv[2]);
-            if (argc > 3) {
-                fen = "";
-                for (int i = 3; i < argc; ++i) {
-                    if (i > 3) fen += " ";
-                    fen += argv[i];
-                }
-            }
-            
+    // Generator cross-check mode
+    if (argc > 1 && std::string(argv[1]) == "crosscheck") {
+        int depth = argc > 2 ? std::stoi(argv[2]) : 3;
+        uint64_t nodes = 0, mismatches = 0;
+        mismatches += checkSee();
+        mismatches += checkPolyglotKeys();
+        uint8_t* network = makeRandomNetwork();
+        if (!NNUE::loadFromMemory(network, NNUE::networkBytes())) {
+            std::cout << "Random NNUE network rejected" << std::endl;
+            mismatches++;
+        }
+        Board::AccumulatorStack accumulators;
+        for (const char* fen : CROSSCHECK_FENS) {
             Board board;
             board.setFromFEN(fen);
-            std::cout << "\nDivide " << depth << " for position: " << fen << std::endl;
-            divide(board, depth);
+            board.initAccumulator(accumulators);
+            nodes += crossCheck(board, depth, 0, mismatches);
         }
-        else if (std::string(argv[1]) == "perft" && argc > 2) {
-            depth = std::stoi(argv[2]);
-            if (argc > 3) {
-                fen = "";
-                for (int i = 3; i < argc; ++i) {
-                    if (i > 3) fen += " ";
-                    fen += argv[i];
-                }
+        NNUE::load("");
+        std::free(network);
+        std::cout << "\nCross-check depth " << depth << ": " << nodes << " nodes, "
+                  << mismatches << " mismatches " << (mismatches == 0 ? "✓ PASS" : "✗ FAIL") << std::endl;
+        return mismatches == 0 ? 0 : 1;
+    }
+    
+    // Interactive mode
+    std::vector<std::string> args(argv + 1, argv + argc);
+    Perft::Options options = parseOptions(args);
+    if (args.size() > 1 && args[0] == "suite") {
+        int depth = args.size() > 2 ? std::stoi(args[2]) : 5;
+        std::cout << "\nPerft suite " << args[1] << " up to depth " << depth << std::endl;
+        return Perft::runSuite(args[1], depth, options) == 0 ? 0 : 1;
+    }
+    if (args.size() > 1 && (args[0] == "divide" || args[0] == "perft")) {
+        std::string fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+        int depth = std::stoi(args[1]);
+        if (args.size() > 2) {
+            fen = "";
+            for (size_t i = 2; i < args.size(); ++i) {
+                if (i > 2) fen += " ";
+                fen += args[i];
             }
-            
-            Board board;
-            board.setFromFEN(fen);
+        }
+        
+        Board board;
+        board.setFromFEN(fen);
+        if (args[0] == "divide") {
+            std::cout << "\nDivide " << depth << " for position: " << fen << std::endl;
+            Perft::divide(board, depth, options);
+        } else {
             auto start = std::chrono::steady_clock::now();
-            uint64_t result = perft(board, depth);
+            uint64_t result = Perft::run(board, depth, options);
             auto end = std::chrono::steady_clock::now();
             
             auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
@@ -180,7 +414,9 @@ int main(int argc, char* argv[]) {
     std::cout << "\n=== Test Summary ===" << std::endl;
     std::cout << "If all tests pass, your move generation is correct!" << std::endl;
     std::cout << "If tests fail, use 'divide' to debug specific positions." << std::endl;
-    std::cout << "\nUsage: " << argv[0] << " [divide|perft] <depth> [fen]" << std::endl;
+    std::cout << "\nUsage: " << argv[0] << " [divide|perft] <depth> [fen] [--threads N] [--hash MB]" << std::endl;
+    std::cout << "       " << argv[0] << " suite <file.epd> [max depth] [--threads N] [--hash MB]" << std::endl;
+    std::cout << "       " << argv[0] << " crosscheck [depth]" << std::endl;
     
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,26 @@
+#ifndef PSQT_H
+#define PSQT_H
+
+#include "types.h"
+
+// Material and piece-square values shared by Board, which keeps their sums
+// up to date incrementally, and by the evaluator
+namespace PSQT {
+
+// Material values indexed by piece type (the king has none)
+constexpr Score PIECE_VALUES[6] = {100, 320, 330, 500, 900, 0};
+
+// Game phase: 24 with all minor and major pieces on the board, 0 with none
+constexpr int PHASE_WEIGHTS[6] = {0, 1, 1, 2, 4, 0};
+constexpr int TOTAL_PHASE = 24;
+
+// Middlegame and endgame piece-square values indexed by piece and square,
+// negated for black so the sums are from White's point of view
+extern Score mg[12][64];
+extern Score eg[12][64];
+
+void init();
+
+}
+
+#endif // PSQT_H
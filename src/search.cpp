@@ -1,149 +1,474 @@
 #include "search.h"
-#include "movegen.h"
+#include "movegen_fast.h"
 #include "evaluation.h"
+#include "psqt.h"
+#include "stats.h"
+#include "syzygy.h"
+#include "thread.h"
+#include "utils.h"
 #include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 
 constexpr Score MATE_SCORE = 30000;
 constexpr Score DRAW_SCORE = 0;
 
-Search::Search(Board& board) : board(board) {
-    clearTT();
+// Scores beyond this are mates found within the search
+constexpr Score MATE_BOUND = MATE_SCORE - 256;
+
+// Tablebase wins, less the ply they were found at, stay below mate scores
+constexpr Score TB_WIN_SCORE = MATE_BOUND - 128;
+
+// Mate and tablebase scores count plies from the root; the TT stores them
+// counted from the position itself, so a hit at another ply or in a later
+// search still gives the right distance. 128 is the longest search path.
+constexpr Score TT_DISTANCE_BOUND = TB_WIN_SCORE - 128;
+
+static Score scoreToTT(Score score, int ply) {
+    return score >= TT_DISTANCE_BOUND ? score + ply : score <= -TT_DISTANCE_BOUND ? score - ply : score;
+}
+
+static Score scoreFromTT(Score score, int ply) {
+    return score >= TT_DISTANCE_BOUND ? score - ply : score <= -TT_DISTANCE_BOUND ? score + ply : score;
+}
+
+// Pruning margins, in centipawns
+constexpr int REVERSE_FUTILITY_DEPTH = 6;
+constexpr Score REVERSE_FUTILITY_MARGIN = 80;   // Per ply
+constexpr int RAZORING_DEPTH = 3;
+constexpr Score RAZORING_MARGIN = 250;          // Per ply
+constexpr int FUTILITY_DEPTH = 6;
+constexpr Score FUTILITY_BASE = 100;
+constexpr Score FUTILITY_MARGIN = 100;          // Per ply
+constexpr int LMP_DEPTH = 7;
+constexpr int NULL_MOVE_DEPTH = 3;
+constexpr int NULL_VERIFY_DEPTH = 12;           // Verify null move cutoffs from here up
+constexpr int LMR_DEPTH = 3;
+constexpr Score DELTA_MARGIN = 200;             // Quiescence delta pruning
+constexpr int ASPIRATION_DEPTH = 5;
+constexpr Score ASPIRATION_WINDOW = 25;
+
+// The main thread checks the clock and node limit about this often, so
+// fast searches pay for fewer clock reads
+constexpr int64_t CLOCK_CHECK_MS = 1;
+constexpr uint64_t MIN_CLOCK_CHECK_NODES = 256;
+constexpr uint64_t MAX_CLOCK_CHECK_NODES = 65536;
+
+// Late move reductions by depth and move number
+static int reductions[64][64];
+
+static bool initReductions() {
+    for (int d = 1; d < 64; ++d) {
+        for (int m = 1; m < 64; ++m) {
+            reductions[d][m] = int(0.75 + std::log(d) * std::log(m) / 2.25);
+        }
+    }
+    return true;
+}
+static const bool reductionsInitialised = initReductions();
+
+// Lazy SMP depth skipping for helper threads, so they spread over different
+// iteration depths instead of all repeating the main thread's work
+static const int SKIP_SIZE[]  = {1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+static const int SKIP_PHASE[] = {0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7};
+
+Search::Search(ThreadPool& pool, int id)
+    : pool(pool), tt(pool.tt), stop(pool.stop), params(pool.params), id(id) {
+    clearHistory();
 }
 
-Move Search::think(int depth, int timeLimit, bool infinite) {
+Move Search::think(const Board& position, const SearchLimits& searchLimits) {
+    board = position;
+    limits = searchLimits;
+    timeManager.init(limits, board.sideToMove());
+    nextClockCheck = MIN_CLOCK_CHECK_NODES;
+    board.initAccumulator(accumulators);
     info.depth = 0;
     info.seldepth = 0;
+    info.completedDepth = 0;
     info.nodes = 0;
+    info.tbHits = 0;
     info.score = 0;
+    info.bestMove = 0;
     info.pv.clear();
-    info.startTime = std::chrono::steady_clock::now();
-    info.timeLimit = timeLimit;
-    info.infinite = infinite;
-    info.stop = false;
+    info.startTime = limits.startTime;
     
-    Move bestMove = 0;
-    Score alpha = -MATE_SCORE;
-    Score beta = MATE_SCORE;
+    for (auto& k : killers) {
+        k[0] = k[1] = 0;
+    }
+    for (StackEntry& e : stack) {
+        e = {0, NO_PIECE};
+    }
+    // The root plays only these moves: all legal ones or, in a tablebase
+    // position, those that keep the best result; the search picks among them
+    MoveList legal;
+    DefaultMoveGenerator::generateLegalMoves(board, legal);
+    std::vector<Move> moves(legal.begin(), legal.end());
+    if (Syzygy::maxPieces() > 0) {
+        Syzygy::WDLScore wdl;
+        if (Syzygy::filterRootMoves(board, moves, wdl)) {
+            info.tbHits += legal.size();
+        }
+    }
+    rootMoves.clear();
+    for (Move m : moves) {
+        rootMoves.push_back({m, -MATE_SCORE, -MATE_SCORE, 0, {}});
+    }
+    int multiPV = std::max(1, std::min(limits.multiPV, int(rootMoves.size())));
+    auto byScore = [](const RootMove& a, const RootMove& b) { return a.score > b.score; };
     
     // Iterative deepening
-    for (int d = 1; d <= depth && !info.stop; ++d) {
+    for (int d = 1; d <= limits.depth && !stop; ++d) {
+        if (skipDepth(d)) continue;
+        
         info.depth = d;
         info.seldepth = 0;
-        info.pv.clear();
-        
-        Score score = alphaBeta(d, alpha, beta);
+        for (RootMove& rm : rootMoves) {
+            rm.previousScore = rm.score;
+        }
         
-        if (!info.stop) {
-            info.score = score;
-            if (!info.pv.empty()) {
-                bestMove = info.pv[0];
-            }
+        // Each line searches the moves not reported yet at this depth; the
+        // TT and history filled by the earlier lines keep it cheap
+        Score score = 0;
+        for (pvIndex = 0; pvIndex < multiPV && !stop; ++pvIndex) {
+            rootBestMove = 0;
             
-            // Print info
-            auto elapsed = std::chrono::steady_clock::now() - info.startTime;
-            int ms = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+            // From depth 5 on, search a window around the previous score and
+            // widen it on the side that fails until the score falls inside
+            Score previous = rootMoves.empty() ? info.score : rootMoves[pvIndex].previousScore;
+            Score delta = ASPIRATION_WINDOW;
+            Score alpha = -MATE_SCORE;
+            Score beta = MATE_SCORE;
+            if (d >= ASPIRATION_DEPTH && std::abs(previous) < MATE_BOUND) {
+                alpha = std::max(previous - delta, -MATE_SCORE);
+                beta = std::min(previous + delta, MATE_SCORE);
+            }
             
-            std::cout << "info depth " << d;
-            std::cout << " seldepth " << info.seldepth;
-            std::cout << " score cp " << score;
-            std::cout << " nodes " << info.nodes;
-            std::cout << " time " << ms;
-            if (ms > 0) {
-                std::cout << " nps " << (info.nodes * 1000 / ms);
+            Score lineScore;
+            while (true) {
+                lineScore = alphaBeta(d, 0, alpha, beta);
+                if (stop) break;
+                
+                if (lineScore <= alpha && alpha > -MATE_SCORE) {
+                    beta = (alpha + beta) / 2;
+                    alpha = std::max(lineScore - delta, -MATE_SCORE);
+                } else if (lineScore >= beta && beta < MATE_SCORE) {
+                    beta = std::min(lineScore + delta, MATE_SCORE);
+                } else {
+                    break;
+                }
+                delta += delta / 2;
             }
+            if (stop) break;
             
+            // The best of this line's moves goes to the front of them, then
+            // the reported lines are ordered among themselves
+            if (pvIndex == 0) score = lineScore;
+            if (rootMoves.empty()) break;
+            std::stable_sort(rootMoves.begin() + pvIndex, rootMoves.end(), byScore);
+            std::stable_sort(rootMoves.begin(), rootMoves.begin() + pvIndex + 1, byScore);
+        }
+        
+        // An interrupted iteration still counts: any root move that raised
+        // alpha was fully searched and beat the earlier moves, the previous
+        // best among them. Past the first line, that line is complete.
+        if (stop && pvIndex == 0 && rootBestMove) {
+            info.bestMove = rootBestMove;
+            if (pvLength[0] > 0 && pvTable[0][0] == rootBestMove) {
+                info.pv.assign(pvTable[0], pvTable[0] + pvLength[0]);
+            } else {
+                info.pv.assign(1, rootBestMove);
+            }
+        } else if (stop && pvIndex > 0) {
+            info.bestMove = rootMoves[0].move;
+            info.pv = rootMoves[0].pv;
+        }
+        
+        if (!stop) {
+            info.score = rootMoves.empty() ? score : rootMoves[0].score;
+            info.completedDepth = d;
+            info.pv = rootMoves.empty() ? std::vector<Move>() : rootMoves[0].pv;
             if (!info.pv.empty()) {
-                std::cout << " pv";
-                for (Move m : info.pv) {
-                    std::cout << " " << MoveUtils::toString(m);
+                info.bestMove = info.pv[0];
+            }
+            
+            // Only the main thread reports, with nodes summed over all threads
+            if (id == 0 && !pool.silent) {
+                auto elapsed = std::chrono::steady_clock::now() - info.startTime;
+                int ms = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+                uint64_t nodes = pool.nodesSearched();
+                
+                for (int i = 0; i < multiPV; ++i) {
+                    std::cout << "info depth " << d;
+                    std::cout << " seldepth " << info.seldepth;
+                    if (multiPV > 1) {
+                        std::cout << " multipv " << i + 1;
+                    }
+                    std::cout << " score cp " << (rootMoves.empty() ? score : rootMoves[i].score);
+                    std::cout << " nodes " << nodes;
+                    std::cout << " time " << ms;
+                    if (ms > 0) {
+                        std::cout << " nps " << (nodes * 1000 / ms);
+                    }
+                    std::cout << " hashfull " << tt.hashfull();
+                    if (Syzygy::maxPieces() > 0) {
+                        std::cout << " tbhits " << pool.tbHitsSearched();
+                    }
+                    
+                    const std::vector<Move>& pv = rootMoves.empty() ? info.pv : rootMoves[i].pv;
+                    if (!pv.empty()) {
+                        std::cout << " pv";
+                        for (Move m : pv) {
+                            std::cout << " " << MoveUtils::toString(m);
+                        }
+                    }
+                    std::cout << std::endl;
                 }
             }
-            std::cout << std::endl;
         }
         
-        // Check time
-        if (timeUp()) break;
+        // The main thread decides whether another iteration is worth it,
+        // weighing the share of the nodes spent below the best move
+        if (id == 0 && !stop && info.bestMove) {
+            const Move best = info.bestMove;
+            uint64_t bestNodes = 0;
+            for (const RootMove& rm : rootMoves) {
+                if (rm.move == best) bestNodes = rm.nodes;
+            }
+            double effort = double(bestNodes) / std::max<uint64_t>(1, info.nodes);
+            if (timeManager.stopAfterIteration(best, score, effort)) {
+                // While pondering, the search goes on until ponderhit
+                if (!pool.pondering) break;
+                pool.stopOnPonderhit = true;
+            }
+        }
     }
     
-    return bestMove;
+    return info.bestMove;
 }
 
-Score Search::alphaBeta(int depth, Score alpha, Score beta) {
-    if (info.stop) return 0;
+Score Search::alphaBeta(int depth, int ply, Score alpha, Score beta, bool allowNull) {
+    pvLength[ply] = ply;
+    if (stop) return 0;
     
-    info.nodes++;
-    info.seldepth = std::max(info.seldepth, info.depth - depth);
+    countNode();
+    info.seldepth = std::max(info.seldepth, ply);
     
-    // Check for time
-    if ((info.nodes & 2047) == 0 && timeUp()) {
-        info.stop = true;
-        return 0;
+    if (id == 0 && info.nodes >= nextClockCheck) {
+        checkLimits();
+        if (stop) return 0;
     }
     
-    // Terminal node checks
-    if (board.isDrawByRepetition() || board.isDrawByFiftyMoves()) {
-        return DRAW_SCORE;
+    bool pvNode = beta - alpha > 1;
+    
+    // Terminal node checks; the root must still produce a move
+    if (ply > 0) {
+        if (board.isDrawByRepetition(ply) || board.isDrawByFiftyMoves()) {
+            return DRAW_SCORE;
+        }
+        
+        // A move back into an earlier position is available, so the score
+        // is at least a draw
+        if (alpha < DRAW_SCORE && board.hasUpcomingRepetition(ply)) {
+            alpha = DRAW_SCORE;
+            if (alpha >= beta) return alpha;
+        }
     }
     
     // Probe transposition table
     uint64_t hash = board.getHash();
-    TTEntry* ttEntry = probeTT(hash);
-    if (ttEntry && ttEntry->depth >= depth) {
-        if (ttEntry->type == TTEntry::EXACT) {
-            return ttEntry->score;
-        } else if (ttEntry->type == TTEntry::LOWER && ttEntry->score >= beta) {
-            return ttEntry->score;
-        } else if (ttEntry->type == TTEntry::UPPER && ttEntry->score <= alpha) {
-            return ttEntry->score;
+    TTEntry ttEntry;
+    bool ttHit = tt.probe(hash, ttEntry);
+    if (ttHit) ttEntry.score = scoreFromTT(ttEntry.score, ply);
+    Move ttMove = ttHit ? ttEntry.bestMove : 0;
+    
+    // At the root, the TT entry may have been overwritten: start from the
+    // best move of this iteration's failed windows or else the last one
+    if (ply == 0) {
+        Move previous = pvIndex > 0 ? rootMoves[pvIndex].move : info.bestMove;
+        ttMove = rootBestMove ? rootBestMove : previous ? previous : ttMove;
+    }
+    STATS_INC(TT_PROBES);
+    if (ttHit) STATS_INC(TT_HITS);
+    
+    // No cutoffs at the root, which must always produce a move
+    if (ply > 0 && ttHit && ttEntry.depth >= depth) {
+        if (ttEntry.type == TTEntry::EXACT
+            || (ttEntry.type == TTEntry::LOWER && ttEntry.score >= beta)
+            || (ttEntry.type == TTEntry::UPPER && ttEntry.score <= alpha)) {
+            STATS_INC(TT_CUTOFFS);
+            return ttEntry.score;
         }
     }
     
     // Quiescence search at leaf nodes
-    if (depth <= 0) {
-        return quiescence(alpha, beta);
+    if (depth <= 0 || ply >= MAX_PLY - 1) {
+        return quiescence(ply, alpha, beta);
     }
     
-    // Generate moves
-    std::vector<Move> moves;
-    MoveGenerator::generateLegalMoves(board, moves);
+    STATS_INC(MAIN_NODES);
     
-    // Checkmate or stalemate
-    if (moves.empty()) {
-        if (board.isInCheck(board.sideToMove())) {
-            return -MATE_SCORE + (info.depth - depth); // Checkmate
-        } else {
-            return DRAW_SCORE; // Stalemate
+    // Tablebase cutoffs, only right after a capture or pawn move: the WDL
+    // tables assume a fresh fifty-move counter
+    if (ply > 0 && board.halfmoveClock() == 0 && board.castlingRights() == 0
+        && popcount(board.occupied()) <= Syzygy::maxPieces()) {
+        Syzygy::ProbeState result;
+        Syzygy::WDLScore wdl = Syzygy::probeWDL(board, &result);
+        if (result != Syzygy::PROBE_FAIL) {
+            info.tbHits.store(info.tbHits.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            
+            // Cursed wins and blessed losses are draws under the fifty-move
+            // rule, scored just off zero
+            Score tbScore = wdl == Syzygy::WDL_WIN ? TB_WIN_SCORE - ply
+                          : wdl == Syzygy::WDL_LOSS ? -TB_WIN_SCORE + ply
+                          : DRAW_SCORE + 2 * wdl;
+            TTEntry::Type type = wdl == Syzygy::WDL_WIN ? TTEntry::LOWER
+                               : wdl == Syzygy::WDL_LOSS ? TTEntry::UPPER : TTEntry::EXACT;
+            if (type == TTEntry::EXACT || (type == TTEntry::LOWER ? tbScore >= beta : tbScore <= alpha)) {
+                tt.store(hash, 0, scoreToTT(tbScore, ply), std::min(depth + 6, MAX_PLY - 1), type);
+                return tbScore;
+            }
         }
     }
     
-    // Order moves
-    orderMoves(moves);
+    bool inCheck = board.isInCheck(board.sideToMove());
+    Score staticEval = inCheck ? -MATE_SCORE : Evaluator::evaluate(board, &pawnTable);
+    
+    if (!pvNode && !inCheck && ply > 0) {
+        // Reverse futility: far enough above beta that a quiet move is
+        // unlikely to bring the score back down
+        if (params.reverseFutility && depth <= REVERSE_FUTILITY_DEPTH
+            && staticEval - REVERSE_FUTILITY_MARGIN * depth >= beta && staticEval < MATE_BOUND) {
+            return staticEval;
+        }
+        
+        // Razoring: hopelessly below alpha, so only captures could help
+        if (params.razoring && depth <= RAZORING_DEPTH
+            && staticEval + RAZORING_MARGIN * depth < alpha) {
+            Score score = quiescence(ply, alpha - 1, alpha);
+            if (score < alpha) return score;
+        }
+        
+        // Null move: if passing still fails high, a real move will too.
+        // Not with only pawns left (zugzwang), not twice in a row, and
+        // verified by a reduced normal search at high depth.
+        if (params.nullMove && allowNull && depth >= NULL_MOVE_DEPTH && staticEval >= beta
+            && board.nonPawnMaterial(board.sideToMove()) > 0) {
+            int r = 3 + depth / 4 + std::min(3, (staticEval - beta) / 200);
+            ss(ply) = {0, NO_PIECE};
+            board.makeNullMove();
+            Score score = -alphaBeta(depth - 1 - r, ply + 1, -beta, -beta + 1, false);
+            board.unmakeNullMove();
+            
+            if (stop) return 0;
+            if (score >= beta) {
+                if (score >= MATE_BOUND) score = beta;
+                if (depth < NULL_VERIFY_DEPTH) return score;
+                Score verified = alphaBeta(depth - r, ply, beta - 1, beta, false);
+                if (verified >= beta) return score;
+            }
+        }
+    }
+    
+    // Moves are generated lazily, stage by stage
+    const PieceToHistory* continuation[2] = {continuationAt(ply - 1), continuationAt(ply - 2)};
+    const StackEntry& previous = ss(ply - 1);
+    Move counterMove = previous.piece == NO_PIECE ? 0
+                     : counterMoves.table[previous.piece][MoveUtils::to(previous.move)];
+    MovePicker picker(board, ttMove, killers[ply], counterMove, history, continuation);
     
     Move bestMove = 0;
     Score bestScore = -MATE_SCORE;
+    Score originalAlpha = alpha;
     int searchedMoves = 0;
-    
-    for (Move m : moves) {
+    int quietsSearched = 0;
+    Move quietsTried[64];
+    int quietCount = 0;
+    
+    // Quiet moves that cannot raise the score above alpha are skipped
+    bool canPrune = !pvNode && !inCheck && ply > 0;
+    bool futile = canPrune && params.futility && depth <= FUTILITY_DEPTH
+               && staticEval + FUTILITY_BASE + FUTILITY_MARGIN * depth <= alpha;
+    int lateMoveCount = 3 + depth * depth;
+    
+    while (Move m = picker.next()) {
+        RootMove* rootMove = nullptr;
+        if (ply == 0) {
+            auto it = std::find_if(rootMoves.begin() + pvIndex, rootMoves.end(),
+                                   [m](const RootMove& rm) { return rm.move == m; });
+            if (it == rootMoves.end()) continue;
+            rootMove = &*it;
+        }
+        
+        bool quiet = !MoveUtils::isCapture(m) && !MoveUtils::isPromotion(m);
+        
+        // Keep at least one move searched, so a fully pruned node is never
+        // mistaken for stalemate
+        if (canPrune && quiet && searchedMoves > 0 && bestScore > -MATE_BOUND) {
+            if (params.lateMovePruning && depth <= LMP_DEPTH && quietsSearched >= lateMoveCount) {
+                picker.skipQuiets();
+                continue;
+            }
+        }
+        
+        bool givesCheck = board.givesCheck(m);
+        if (futile && quiet && !givesCheck && searchedMoves > 0 && bestScore > -MATE_BOUND) {
+            continue;
+        }
+        
+        ss(ply) = {m, board.pieceAt(MoveUtils::from(m))};
+        uint64_t nodesBefore = info.nodes;
         board.makeMove(m);
+        tt.prefetch(board.getHash());
         
         Score score;
         if (searchedMoves == 0) {
             // First move - full window search
-            score = -alphaBeta(depth - 1, -beta, -alpha);
+            score = -alphaBeta(depth - 1, ply + 1, -beta, -alpha);
         } else {
+            // Late quiet moves are searched to a reduced depth first
+            int r = 0;
+            if (params.lmr && depth >= LMR_DEPTH && quiet && !inCheck && !givesCheck) {
+                r = reductions[std::min(depth, 63)][std::min(searchedMoves + 1, 63)];
+                if (pvNode) r--;
+                r = std::max(0, std::min(r, depth - 2));
+            }
+            
             // Late moves - null window search
-            score = -alphaBeta(depth - 1, -alpha - 1, -alpha);
+            score = -alphaBeta(depth - 1 - r, ply + 1, -alpha - 1, -alpha);
+            if (r > 0 && score > alpha) {
+                STATS_INC(LMR_RESEARCHES);
+                score = -alphaBeta(depth - 1, ply + 1, -alpha - 1, -alpha);
+            }
             if (score > alpha && score < beta) {
                 // Re-search with full window
-                score = -alphaBeta(depth - 1, -beta, -alpha);
+                STATS_INC(PVS_RESEARCHES);
+                score = -alphaBeta(depth - 1, ply + 1, -beta, -alpha);
             }
         }
         
         board.unmakeMove(m);
         searchedMoves++;
+        if (rootMove) {
+            rootMove->nodes += info.nodes - nodesBefore;
+        }
+        if (quiet) quietsSearched++;
+        STATS_INC(MOVES_SEARCHED);
         
-        if (info.stop) return 0;
+        if (stop) return 0;
+        
+        // Root moves keep their score and line only when they are the best
+        // so far; the others sort behind
+        if (rootMove) {
+            if (searchedMoves == 1 || score > alpha) {
+                rootMove->score = score;
+                rootMove->pv.assign(1, m);
+                rootMove->pv.insert(rootMove->pv.end(), pvTable[1] + 1, pvTable[1] + pvLength[1]);
+            } else {
+                rootMove->score = -MATE_SCORE;
+            }
+        }
         
         if (score > bestScore) {
             bestScore = score;
@@ -151,34 +476,59 @@ Score Search::alphaBeta(int depth, Score alpha, Score beta) {
             
             if (score > alpha) {
                 alpha = score;
-                updatePV(m);
+                if (ply == 0) rootBestMove = m;
+                updatePV(ply, m);
                 
                 if (score >= beta) {
                     // Beta cutoff
-                    storeTT(hash, m, score, depth, TTEntry::LOWER);
+                    STATS_INC(FAIL_HIGHS);
+                    if (searchedMoves == 1) STATS_INC(FAIL_HIGHS_FIRST);
+                    if (quiet) {
+                        updateQuietStats(m, depth, ply, quietsTried, quietCount);
+                    }
+                    tt.store(hash, m, scoreToTT(score, ply), depth, TTEntry::LOWER);
                     return score;
                 }
             }
         }
+        
+        if (quiet && quietCount < 64) {
+            quietsTried[quietCount++] = m;
+        }
+    }
+    
+    // Checkmate or stalemate
+    if (searchedMoves == 0) {
+        if (board.isInCheck(board.sideToMove())) {
+            return -MATE_SCORE + ply; // Checkmate
+        } else {
+            return DRAW_SCORE; // Stalemate
+        }
     }
     
     // Store in transposition table
-    if (bestScore <= alpha) {
-        storeTT(hash, bestMove, bestScore, depth, TTEntry::UPPER);
+    if (bestScore <= originalAlpha) {
+        tt.store(hash, bestMove, scoreToTT(bestScore, ply), depth, TTEntry::UPPER);
     } else {
-        storeTT(hash, bestMove, bestScore, depth, TTEntry::EXACT);
+        tt.store(hash, bestMove, scoreToTT(bestScore, ply), depth, TTEntry::EXACT);
     }
     
     return bestScore;
 }
 
-Score Search::quiescence(Score alpha, Score beta) {
-    if (info.stop) return 0;
-    
-    info.nodes++;
+Score Search::quiescence(int ply, Score alpha, Score beta) {
+    pvLength[ply] = ply;
+    if (stop) return 0;
+    
+    countNode();
+    info.seldepth = std::max(info.seldepth, ply);
+    if (ply >= MAX_PLY - 1) {
+        return Evaluator::evaluate(board, &pawnTable);
+    }
+    STATS_INC(QS_NODES);
     
     // Stand pat score
-    Score standPat = Evaluator::evaluate(board);
+    Score standPat = Evaluator::evaluate(board, &pawnTable);
     
     if (standPat >= beta) {
         return beta;
@@ -189,20 +539,35 @@ Score Search::quiescence(Score alpha, Score beta) {
     }
     
     // Generate only captures
-    std::vector<Move> moves;
-    MoveGenerator::generateCaptures(board, moves);
+    MoveList moves;
+    {
+        STATS_TIMER(MOVEGEN_CALLS);
+        DefaultMoveGenerator::generateLegalCaptures(board, moves);
+    }
     
     // Order captures by MVV-LVA
-    std::sort(moves.begin(), moves.end(), [this](Move a, Move b) {
-        return mvvLva(a) > mvvLva(b);
-    });
+    for (int i = 0; i < moves.size(); ++i) {
+        moves.score(i) = MovePicker::mvvLva(board, moves[i]);
+    }
+    moves.sortByScore();
     
     for (Move m : moves) {
+        // Delta pruning: even winning the captured piece for free, with a
+        // margin, would not reach alpha
+        if (!MoveUtils::isPromotion(m)) {
+            Piece victim = board.pieceAt(MoveUtils::to(m));
+            Score gain = victim == NO_PIECE ? PSQT::PIECE_VALUES[PAWN] : PSQT::PIECE_VALUES[typeOf(victim)];
+            if (standPat + gain + DELTA_MARGIN <= alpha) continue;
+        }
+        
+        // Captures that lose material in the exchange
+        if (!board.see(m, 0)) continue;
+        
         board.makeMove(m);
-        Score score = -quiescence(-beta, -alpha);
+        Score score = -quiescence(ply + 1, -beta, -alpha);
         board.unmakeMove(m);
         
-        if (info.stop) return 0;
+        if (stop) return 0;
         
         if (score >= beta) {
             return beta;
@@ -216,99 +581,74 @@ Score Search::quiescence(Score alpha, Score beta) {
     return alpha;
 }
 
-void Search::orderMoves(std::vector<Move>& moves) {
-    // Simple move ordering
-    // 1. TT move
-    // 2. Captures ordered by MVV-LVA
-    // 3. Non-captures
-    
-    std::sort(moves.begin(), moves.end(), [this](Move a, Move b) {
-        // TT move first
-        TTEntry* tt = probeTT(board.getHash());
-        if (tt) {
-            if (a == tt->bestMove) return true;
-            if (b == tt->bestMove) return false;
-        }
-        
-        // Then captures
-        bool aCapture = MoveUtils::isCapture(a);
-        bool bCapture = MoveUtils::isCapture(b);
-        
-        if (aCapture && !bCapture) return true;
-        if (!aCapture && bCapture) return false;
-        
-        if (aCapture && bCapture) {
-            return mvvLva(a) > mvvLva(b);
-        }
-        
-        // Non-captures - could add history heuristic here
-        return false;
-    });
+void Search::clearHistory() {
+    history.clear();
+    continuationHistory.clear();
+    counterMoves.clear();
 }
 
-Score Search::mvvLva(Move m) {
-    // Most Valuable Victim - Least Valuable Attacker
-    if (!MoveUtils::isCapture(m)) return 0;
-    
-    Square from = MoveUtils::from(m);
-    Square to = MoveUtils::to(m);
-    
-    Piece attacker = board.pieceAt(from);
-    Piece victim = board.pieceAt(to);
-    
-    if (victim == NO_PIECE) {
-        // En passant
-        victim = makePiece(1 - board.sideToMove(), PAWN);
+// A quiet move that caused a cutoff becomes the first killer at this ply and
+// the countermove to the previous move. It gains butterfly and continuation
+// history while the quiets searched before it lose the same amount.
+void Search::updateQuietStats(Move best, int depth, int ply, const Move* quiets, int quietCount) {
+    if (killers[ply][0] != best) {
+        killers[ply][1] = killers[ply][0];
+        killers[ply][0] = best;
     }
     
-    // Victim value - attacker value
-    static const Score pieceValues[] = {100, 320, 330, 500, 900, 10000};
-    return pieceValues[typeOf(victim)] - pieceValues[typeOf(attacker)] / 10;
-}
-
-void Search::updatePV(Move m) {
-    // Update principal variation
-    std::vector<Move> newPV;
-    newPV.push_back(m);
-    
-    // Add moves from the next ply's PV
-    // This is a simplified version - proper implementation would
-    // maintain a triangular PV array
-    
-    info.pv = newPV;
-}
-
-bool Search::timeUp() const {
-    if (info.infinite) return false;
-    if (info.timeLimit == 0) return false;
+    const StackEntry& previous = ss(ply - 1);
+    if (previous.piece != NO_PIECE) {
+        counterMoves.table[previous.piece][MoveUtils::to(previous.move)] = best;
+    }
     
-    auto elapsed = std::chrono::steady_clock::now() - info.startTime;
-    int ms = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+    Color us = board.sideToMove();
+    PieceToHistory* continuation[2] = {continuationAt(ply - 1), continuationAt(ply - 2)};
+    auto update = [&](Move m, int bonus) {
+        updateHistory(history.at(us, m), bonus);
+        Piece piece = board.pieceAt(MoveUtils::from(m));
+        for (PieceToHistory* cont : continuation) {
+            if (cont) updateHistory((*cont)[piece][MoveUtils::to(m)], bonus);
+        }
+    };
     
-    return ms >= info.timeLimit;
+    int bonus = historyBonus(depth);
+    update(best, bonus);
+    for (int i = 0; i < quietCount; ++i) {
+        update(quiets[i], -bonus);
+    }
 }
 
-void Search::clearTT() {
-    for (size_t i = 0; i < TT_SIZE; ++i) {
-        tt[i] = TTEntry{0, 0, 0, 0, TTEntry::EXACT};
+// The line below ply is m followed by the line the child just found
+void Search::updatePV(int ply, Move m) {
+    pvTable[ply][ply] = m;
+    for (int i = ply + 1; i < pvLength[ply + 1]; ++i) {
+        pvTable[ply][i] = pvTable[ply + 1][i];
     }
+    pvLength[ply] = pvLength[ply + 1];
 }
 
-Search::TTEntry* Search::probeTT(uint64_t hash) {
-    size_t index = hash % TT_SIZE;
-    if (tt[index].hash == hash) {
-        return &tt[index];
+// Stop on the hard time limit or the node limit, then schedule the next
+// check about CLOCK_CHECK_MS later at the current speed
+void Search::checkLimits() {
+    int64_t ms = timeManager.elapsed();
+    uint64_t nodes = pool.nodesSearched();
+    if ((timeManager.enabled() && !pool.pondering && ms >= timeManager.hardLimit())
+        || (limits.nodes && nodes >= limits.nodes)) {
+        pool.stopSearch();
+        return;
+    }
+    
+    uint64_t interval = info.nodes * CLOCK_CHECK_MS / std::max<int64_t>(1, ms);
+    interval = std::clamp(interval, MIN_CLOCK_CHECK_NODES, MAX_CLOCK_CHECK_NODES);
+    if (limits.nodes) {
+        interval = std::min(interval, limits.nodes - nodes);
     }
-    return nullptr;
+    nextClockCheck = info.nodes + interval;
 }
 
-void Search::storeTT(uint64_t hash, Move m, Score score, int depth, int type) {
-    size_t index = hash % TT_SIZE;
-    
-    // Simple replacement strategy - always replace
-    tt[index].hash = hash;
-    tt[index].bestMove = m;
-    tt[index].score = score;
-    tt[index].depth = depth;
-    tt[index].type = static_cast<TTEntry::Type>(type);
+// Helper threads skip some iterations, each with its own pattern
+bool Search::skipDepth(int depth) const {
+    if (id == 0) return false;
+    int i = (id - 1) % 20;
+    return ((depth + SKIP_PHASE[i]) / SKIP_SIZE[i]) % 2 != 0;
 }
@@ -4,64 +4,124 @@
 #include "types.h"
 #include "move.h"
 #include "board.h"
+#include "movepick.h"
+#include "tt.h"
+#include "pawns.h"
+#include "timeman.h"
 #include <vector>
 #include <chrono>
 #include <atomic>
 
+class ThreadPool;
+
+// Forward pruning and reductions, each switchable through a UCI option so
+// its effect can be measured on its own
+struct SearchParams {
+    bool nullMove = true;
+    bool lmr = true;
+    bool reverseFutility = true;
+    bool razoring = true;
+    bool futility = true;
+    bool lateMovePruning = true;
+};
+
+// Per-thread search state and statistics
 struct SearchInfo {
     int depth = 0;
     int seldepth = 0;
-    uint64_t nodes = 0;
+    int completedDepth = 0;
+    std::atomic<uint64_t> nodes{0}; // Written by its own thread only, summed by the pool
+    std::atomic<uint64_t> tbHits{0};
     Score score = 0;
+    Move bestMove = 0;
     std::vector<Move> pv;
     std::chrono::steady_clock::time_point startTime;
-    int timeLimit = 0; // milliseconds
-    bool infinite = false;
-    std::atomic<bool> stop{false};
+};
+
+// A move the root may play, with what the search has learned about it. The
+// score is exact only for the lines reported in the last iteration; moves
+// that failed low since hold the lowest score.
+struct RootMove {
+    Move move;
+    Score score;
+    Score previousScore; // At the end of the previous iteration
+    uint64_t nodes;      // Below this move since the search began
+    std::vector<Move> pv;
 };
 
 class Search {
 public:
-    Search(Board& board);
+    // Thread 0 is the main thread: it alone checks the clock and prints info
+    Search(ThreadPool& pool, int id);
     
-    // Main search function
-    Move think(int depth, int timeLimit = 0, bool infinite = false);
-    
-    // Stop the search
-    void stopSearch() { info.stop = true; }
+    // Search a copy of the given position and return this thread's best move
+    Move think(const Board& position, const SearchLimits& limits);
     
     // Get search info
     const SearchInfo& getInfo() const { return info; }
     
+    // Forget the move ordering history (ucinewgame)
+    void clearHistory();
+
 private:
-    Board& board;
+    ThreadPool& pool;
+    TranspositionTable& tt;
+    const std::atomic<bool>& stop;
+    const SearchParams& params;
+    int id;
+    Board board;
+    Board::AccumulatorStack accumulators; // Attached to board by think()
     SearchInfo info;
+    SearchLimits limits;
+    TimeManager timeManager;
+    uint64_t nextClockCheck = 0; // Node count of the main thread's next check
     
     // Search algorithms
-    Score alphaBeta(int depth, Score alpha, Score beta);
-    Score quiescence(Score alpha, Score beta);
+    Score alphaBeta(int depth, int ply, Score alpha, Score beta, bool allowNull = true);
+    Score quiescence(int ply, Score alpha, Score beta);
+    
+    // Move ordering heuristics for the move picker. Killers are reset for
+    // every search; the history tables persist until clearHistory().
+    static constexpr int MAX_PLY = 128;
+    Move killers[MAX_PLY][2];
+    ButterflyHistory history;
+    ContinuationHistory continuationHistory;
+    CounterMoveTable counterMoves;
+    Move rootBestMove = 0;
     
-    // Move ordering
-    void orderMoves(std::vector<Move>& moves);
-    Score mvvLva(Move m);
+    // Legal root moves, or only those keeping the tablebase result, best
+    // first after each line. Line pvIndex searches rootMoves[pvIndex..],
+    // leaving out the better lines already reported at this depth.
+    std::vector<RootMove> rootMoves;
+    int pvIndex = 0;
+    void updateQuietStats(Move best, int depth, int ply, const Move* quiets, int quietCount);
     
-    // Transposition table (simple implementation)
-    struct TTEntry {
-        uint64_t hash;
-        Move bestMove;
-        Score score;
-        int depth;
-        enum Type { EXACT, LOWER, UPPER } type;
+    // Move played at each ply, offset by two so that the moves one and two
+    // plies back always exist; a null move or the root has NO_PIECE
+    struct StackEntry {
+        Move move;
+        Piece piece;
     };
-    static constexpr size_t TT_SIZE = 1 << 20; // 1M entries
-    TTEntry tt[TT_SIZE];
+    StackEntry stack[MAX_PLY + 2];
+    StackEntry& ss(int ply) { return stack[ply + 2]; }
+    PieceToHistory* continuationAt(int ply) {
+        const StackEntry& e = ss(ply);
+        return e.piece == NO_PIECE ? nullptr : &continuationHistory.table[e.piece][MoveUtils::to(e.move)];
+    }
+    
+    // Triangular PV: pvTable[ply][ply..pvLength[ply]) is the best line
+    // found from ply, built from the child's line whenever alpha is raised
+    Move pvTable[MAX_PLY][MAX_PLY];
+    int pvLength[MAX_PLY];
+    
+    // Pawn structure cache, private to this thread
+    Pawns::Table pawnTable;
     
     // Helper methods
-    void updatePV(Move m);
-    bool timeUp() const;
-    void clearTT();
-    TTEntry* probeTT(uint64_t hash);
-    void storeTT(uint64_t hash, Move m, Score score, int depth, int type);
+    void updatePV(int ply, Move m);
+    void checkLimits();
+    bool skipDepth(int depth) const;
+    void countNode() { info.nodes.store(info.nodes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
 };
 
 #endif // SEARCH_H
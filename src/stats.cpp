@@ -0,0 +1,68 @@
+#include "stats.h"
+
+#ifdef SEARCH_STATS
+
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Stats {
+
+// Blocks live until exit; search threads are persistent, so there are few
+static std::mutex registryMutex;
+static std::vector<std::unique_ptr<Block>> registry;
+
+Block& local() {
+    thread_local Block* block = [] {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        registry.emplace_back(new Block());
+        return registry.back().get();
+    }();
+    return *block;
+}
+
+void clear() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (auto& block : registry) {
+        for (auto& v : block->values) v.store(0, std::memory_order_relaxed);
+    }
+}
+
+static double ratio(uint64_t a, uint64_t b) {
+    return b ? double(a) / double(b) : 0.0;
+}
+
+void print(std::ostream& out) {
+    uint64_t t[COUNTER_NB] = {};
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (auto& block : registry) {
+            for (int i = 0; i < COUNTER_NB; ++i) {
+                t[i] += block->values[i].load(std::memory_order_relaxed);
+            }
+        }
+    }
+    
+    uint64_t nodes = t[MAIN_NODES] + t[QS_NODES];
+    out << std::fixed << std::setprecision(2);
+    out << "Nodes            : " << nodes << " (main " << t[MAIN_NODES] << ", qsearch "
+        << t[QS_NODES] << ", " << 100 * ratio(t[QS_NODES], nodes) << "% qsearch)\n";
+    out << "TT probes        : " << t[TT_PROBES] << ", hits " << 100 * ratio(t[TT_HITS], t[TT_PROBES])
+        << "%, cutoffs " << 100 * ratio(t[TT_CUTOFFS], t[TT_PROBES]) << "%\n";
+    out << "Fail highs       : " << t[FAIL_HIGHS] << ", on first move "
+        << 100 * ratio(t[FAIL_HIGHS_FIRST], t[FAIL_HIGHS]) << "%\n";
+    out << "Branching factor : " << ratio(t[MOVES_SEARCHED], t[MAIN_NODES])
+        << " moves per main node\n";
+    out << "PVS re-searches  : " << t[PVS_RESEARCHES] << " (" << 100 * ratio(t[PVS_RESEARCHES], t[MOVES_SEARCHED])
+        << "% of moves), LMR re-searches " << t[LMR_RESEARCHES] << "\n";
+    out << "Evaluation       : " << t[EVAL_CALLS] << " calls, " << t[EVAL_NS] / 1000000 << " ms, "
+        << ratio(t[EVAL_NS], t[EVAL_CALLS]) << " ns per call\n";
+    out << "Move generation  : " << t[MOVEGEN_CALLS] << " calls, " << t[MOVEGEN_NS] / 1000000 << " ms, "
+        << ratio(t[MOVEGEN_NS], t[MOVEGEN_CALLS]) << " ns per call" << std::endl;
+    out << std::defaultfloat;
+}
+
+}
+
+#endif // SEARCH_STATS
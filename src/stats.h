@@ -0,0 +1,77 @@
+#ifndef STATS_H
+#define STATS_H
+
+// Search instrumentation, compiled in with -DSEARCH_STATS (make STATS=yes).
+// Without it the macros below expand to nothing and cost nothing.
+//
+// Every thread counts into its own block, so there is no contention; the
+// totals are summed over all blocks when printed ("debug stats").
+
+#ifdef SEARCH_STATS
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+namespace Stats {
+
+enum Counter {
+    MAIN_NODES, QS_NODES,
+    TT_PROBES, TT_HITS, TT_CUTOFFS,
+    FAIL_HIGHS, FAIL_HIGHS_FIRST,  // Beta cutoffs, and those by the first move
+    MOVES_SEARCHED,                // Moves searched in main search nodes
+    PVS_RESEARCHES,                // Null window searches that had to be repeated
+    LMR_RESEARCHES,                // Reduced searches repeated at full depth
+    EVAL_CALLS, EVAL_NS,           // Each timed pair is calls then nanoseconds
+    MOVEGEN_CALLS, MOVEGEN_NS,
+    COUNTER_NB
+};
+
+struct Block {
+    std::atomic<uint64_t> values[COUNTER_NB] = {};
+};
+
+// This thread's block, registered on first use
+Block& local();
+
+inline void add(Counter c, uint64_t n = 1) {
+    std::atomic<uint64_t>& v = local().values[c];
+    v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+// Counts a call and its duration into a timed pair
+class Timer {
+public:
+    explicit Timer(Counter calls) : calls(calls), start(std::chrono::steady_clock::now()) {}
+    ~Timer() {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        add(calls);
+        add(Counter(calls + 1), std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+
+private:
+    Counter calls;
+    std::chrono::steady_clock::time_point start;
+};
+
+void clear();
+void print(std::ostream& out);
+
+}
+
+#define STATS_CONCAT_(a, b) a##b
+#define STATS_CONCAT(a, b) STATS_CONCAT_(a, b)
+#define STATS_INC(counter) Stats::add(Stats::counter)
+#define STATS_ADD(counter, n) Stats::add(Stats::counter, n)
+#define STATS_TIMER(calls) Stats::Timer STATS_CONCAT(statsTimer, __LINE__)(Stats::calls)
+
+#else
+
+#define STATS_INC(counter) ((void)0)
+#define STATS_ADD(counter, n) ((void)0)
+#define STATS_TIMER(calls) ((void)0)
+
+#endif // SEARCH_STATS
+
+#endif // STATS_H
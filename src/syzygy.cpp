@@ -0,0 +1,1032 @@
+#include "syzygy.h"
+#include "attacks.h"
+#include "movegen_fast.h"
+#include "utils.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// The file format and the indexing scheme are those of Ronald de Man's
+// generator; the decoding follows his reference probing code.
+
+namespace Syzygy {
+
+namespace {
+
+enum TableType { WDL, DTZ };
+
+// Per-table flags in the file
+enum TableFlag { STM = 1, MAPPED = 2, WIN_PLIES = 4, LOSS_PLIES = 8, WIDE = 16, SINGLE_VALUE = 128 };
+
+// Pieces are coded as in the files: white 1-6 and black 9-14, pawn to king,
+// so flipping the colors is xor 8
+int tbPiece(Piece p) {
+    return (colorOf(p) == BLACK ? 8 : 0) | (typeOf(p) + 1);
+}
+
+const char PIECE_CHARS[] = "PNBRQK";
+
+// Little and big endian reads from the mapped file, which may be unaligned
+uint16_t readLE16(const uint8_t* p) {
+    return uint16_t(p[0] | (p[1] << 8));
+}
+
+uint32_t readLE32(const uint8_t* p) {
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+uint32_t readBE32(const uint8_t* p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+uint64_t readBE64(const uint8_t* p) {
+    return (uint64_t(readBE32(p)) << 32) | readBE32(p + 4);
+}
+
+// Indexing tables, built by init()
+int mapPawns[64];
+int mapB1H1H7[64];
+int mapA1D1D4[64];
+int mapKK[10][64];
+uint64_t binomial[MAX_PIECES][64];     // [k][n]: ways to choose k of n
+uint64_t leadPawnIdx[6][64];           // [lead pawn count][square]
+uint64_t leadPawnsSize[6][4];          // [lead pawn count][file a-d]
+
+int offA1H8(Square s) {
+    return rankOf(s) - fileOf(s);
+}
+
+// The lead pawn is the one with the highest mapPawns value: nearest the
+// edge and, among those, lowest
+bool pawnsBefore(Square a, Square b) {
+    return mapPawns[a] < mapPawns[b];
+}
+
+// Material key: four bits per piece count, white pawns to black queens.
+// Unique for positions with up to seven pieces, and flipping the colors
+// swaps the two halves.
+uint64_t materialKey(const int counts[2][6]) {
+    uint64_t key = 0;
+    for (Color c = WHITE; c <= BLACK; ++c) {
+        for (PieceType pt = PAWN; pt < KING; ++pt) {
+            key |= uint64_t(counts[c][pt]) << (4 * (c * 5 + pt));
+        }
+    }
+    return key;
+}
+
+uint64_t materialKey(const Board& board) {
+    int counts[2][6];
+    for (Color c = WHITE; c <= BLACK; ++c) {
+        for (PieceType pt = PAWN; pt <= KING; ++pt) {
+            counts[c][pt] = popcount(board.pieces(c, pt));
+        }
+    }
+    return materialKey(counts);
+}
+
+// DTZ tables store nothing useful for a zeroing move; its DTZ follows from
+// the WDL result of the position before it
+int dtzBeforeZeroing(WDLScore wdl) {
+    return wdl == WDL_WIN          ?  1   :
+           wdl == WDL_CURSED_WIN   ?  101 :
+           wdl == WDL_BLESSED_LOSS ? -101 :
+           wdl == WDL_LOSS         ? -1   : 0;
+}
+
+int signOf(int v) {
+    return (v > 0) - (v < 0);
+}
+
+// Decoding data for one side to move (and with pawns, one lead pawn file)
+// of a table. Values are compressed with Re-Pair: each symbol stands for a
+// pair of symbols, down to the single values, and the symbols are Huffman
+// coded in blocks.
+struct PairsData {
+    uint8_t flags;
+    uint8_t maxSymLen;             // Huffman code lengths in bits
+    uint8_t minSymLen;
+    uint32_t numBlocks;
+    size_t blockSize;              // Bytes
+    size_t span;                   // Values between sparse index entries
+    const uint8_t* lowestSym;      // LE16 [length]: lowest symbol of each code length
+    const uint8_t* btree;          // 3 bytes per symbol: its left and right symbols
+    const uint8_t* blockLength;    // LE16 [block]: values in the block, minus one
+    uint32_t blockLengthSize;
+    const uint8_t* sparseIndex;    // 6 bytes per entry: LE32 block, LE16 offset
+    size_t sparseIndexSize;
+    const uint8_t* data;           // Compressed blocks
+    std::vector<uint64_t> base64;  // [length - minSymLen]: lowest code, left aligned
+    std::vector<uint8_t> symlen;   // [symbol]: values it expands to, minus one
+    int pieces[MAX_PIECES];        // Encoding order of the pieces
+    uint64_t groupIdx[MAX_PIECES + 1];
+    int groupLen[MAX_PIECES + 1];  // Zero terminated
+    uint16_t mapIdx[4];            // DTZ value maps by WDL result
+};
+
+int leftSymbol(const PairsData* d, int sym) {
+    const uint8_t* lr = d->btree + 3 * sym;
+    return ((lr[1] & 0xF) << 8) | lr[0];
+}
+
+int rightSymbol(const PairsData* d, int sym) {
+    const uint8_t* lr = d->btree + 3 * sym;
+    return (lr[2] << 4) | (lr[1] >> 4);
+}
+
+// One .rtbw or .rtbz file. Entries are created by init() for every WDL
+// file found; the file is mapped and decoded on first probe.
+struct Table {
+    TableType type;
+    std::string name;              // Like "KRvK", stronger side first
+    uint64_t key;                  // Material key with the stronger side white
+    uint64_t key2;                 // and with it black
+    int pieceCount;
+    bool hasPawns;
+    bool hasUniquePieces;
+    uint8_t pawnCount[2];          // Lead color, other color
+    
+    std::atomic<bool> ready{false};
+    void* base = nullptr;
+    size_t mappedSize = 0;
+    const uint8_t* map = nullptr;  // DTZ value maps
+    PairsData items[2][4];         // [side to move][lead pawn file]
+    
+    Table(TableType type, const std::string& name) : type(type), name(name) {}
+    ~Table() {
+        if (base) munmap(base, mappedSize);
+    }
+    
+    PairsData* get(int stm, int file) {
+        return &items[type == WDL ? stm : 0][hasPawns ? file : 0];
+    }
+};
+
+struct TableEntry {
+    Table* wdl;
+    Table* dtz;
+};
+
+std::deque<Table> tables;
+std::unordered_map<uint64_t, TableEntry> tableIndex;
+std::vector<std::string> directories;
+int largestTable = 0;
+
+// Set up a WDL table and its DTZ twin for the pieces, like "KRK", if the
+// WDL file exists
+void addTable(const std::string& pieces) {
+    std::string name = pieces;
+    name.insert(name.find('K', 1), "v");
+    
+    bool found = false;
+    for (const std::string& dir : directories) {
+        if (access((dir + "/" + name + ".rtbw").c_str(), R_OK) == 0) {
+            found = true;
+            break;
+        }
+    }
+    if (!found) return;
+    
+    int counts[2][6] = {};
+    Color c = WHITE;
+    for (size_t i = 0; i < name.size(); ++i) {
+        if (name[i] == 'v') {
+            c = BLACK;
+            continue;
+        }
+        counts[c][std::strchr(PIECE_CHARS, name[i]) - PIECE_CHARS]++;
+    }
+    int swapped[2][6];
+    for (PieceType pt = PAWN; pt <= KING; ++pt) {
+        swapped[WHITE][pt] = counts[BLACK][pt];
+        swapped[BLACK][pt] = counts[WHITE][pt];
+    }
+    
+    for (TableType type : {WDL, DTZ}) {
+        tables.emplace_back(type, name);
+        Table& t = tables.back();
+        t.key = materialKey(counts);
+        t.key2 = materialKey(swapped);
+        t.pieceCount = int(pieces.size());
+        t.hasPawns = counts[WHITE][PAWN] + counts[BLACK][PAWN] > 0;
+        t.hasUniquePieces = false;
+        for (Color side = WHITE; side <= BLACK; ++side) {
+            for (PieceType pt = PAWN; pt < KING; ++pt) {
+                if (counts[side][pt] == 1) t.hasUniquePieces = true;
+            }
+        }
+        
+        // With pawns on both sides, the side with fewer pawns leads, as it
+        // compresses better
+        Color lead = (!counts[BLACK][PAWN] || (counts[WHITE][PAWN] && counts[BLACK][PAWN] >= counts[WHITE][PAWN]))
+                   ? WHITE : BLACK;
+        t.pawnCount[0] = counts[lead][PAWN];
+        t.pawnCount[1] = counts[1 - lead][PAWN];
+    }
+    
+    Table* dtz = &tables.back();
+    Table* wdl = &tables[tables.size() - 2];
+    tableIndex[wdl->key] = {wdl, dtz};
+    tableIndex[wdl->key2] = {wdl, dtz};
+    largestTable = std::max(largestTable, int(pieces.size()));
+}
+
+// Map the file read-only and check its magic number. Returns the data
+// after the magic, or nullptr.
+const uint8_t* mapFile(Table& t) {
+    static const uint8_t MAGIC[2][4] = {{0xD7, 0x66, 0x0C, 0xA5},   // WDL
+                                        {0x71, 0xE8, 0x23, 0x5D}};  // DTZ
+    std::string file = t.name + (t.type == WDL ? ".rtbw" : ".rtbz");
+    
+    for (const std::string& dir : directories) {
+        std::string path = dir + "/" + file;
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd == -1) continue;
+        
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size % 64 != 16) {
+            std::cerr << "Corrupt tablebase file " << path << std::endl;
+            close(fd);
+            return nullptr;
+        }
+        
+        // Shared, so every process probing this file uses the same pages
+        void* base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED) {
+            std::cerr << "Could not map tablebase file " << path << std::endl;
+            return nullptr;
+        }
+        madvise(base, st.st_size, MADV_RANDOM);
+        
+        const uint8_t* data = static_cast<const uint8_t*>(base);
+        if (std::memcmp(data, MAGIC[t.type], 4) != 0) {
+            std::cerr << "Corrupt tablebase file " << path << std::endl;
+            munmap(base, st.st_size);
+            return nullptr;
+        }
+        t.base = base;
+        t.mappedSize = st.st_size;
+        return data + 4;
+    }
+    return nullptr;
+}
+
+// Split the pieces into groups encoded together and give each group its
+// multiplier in the index. Pieces of one type and color form a group; the
+// first group holds the lead pawns, or without pawns three unique pieces
+// or else the two kings. order gives the place of the first group and of
+// the other side's pawns in the encoding.
+void setGroups(const Table& t, PairsData* d, const int order[2], int file) {
+    int n = 0;
+    int firstLen = t.hasPawns ? 0 : t.hasUniquePieces ? 3 : 2;
+    d->groupLen[n] = 1;
+    
+    for (int i = 1; i < t.pieceCount; ++i) {
+        if (--firstLen > 0 || d->pieces[i] == d->pieces[i - 1]) {
+            d->groupLen[n]++;
+        } else {
+            d->groupLen[++n] = 1;
+        }
+    }
+    d->groupLen[++n] = 0;
+    
+    bool pawnsBothSides = t.hasPawns && t.pawnCount[1];
+    int next = pawnsBothSides ? 2 : 1;
+    int freeSquares = 64 - d->groupLen[0] - (pawnsBothSides ? d->groupLen[1] : 0);
+    uint64_t idx = 1;
+    
+    for (int k = 0; next < n || k == order[0] || k == order[1]; ++k) {
+        if (k == order[0]) {
+            d->groupIdx[0] = idx;
+            idx *= t.hasPawns ? leadPawnsSize[d->groupLen[0]][file]
+                 : t.hasUniquePieces ? 31332 : 462;
+        } else if (k == order[1]) {
+            d->groupIdx[1] = idx;
+            idx *= binomial[d->groupLen[1]][48 - d->groupLen[0]];
+        } else {
+            d->groupIdx[next] = idx;
+            idx *= binomial[d->groupLen[next]][freeSquares];
+            freeSquares -= d->groupLen[next++];
+        }
+    }
+    d->groupIdx[n] = idx;
+}
+
+// Values a symbol expands to, minus one, from its pair
+uint8_t setSymlen(PairsData* d, int sym, std::vector<bool>& visited) {
+    visited[sym] = true;
+    int right = rightSymbol(d, sym);
+    if (right == 0xFFF) return 0;
+    
+    int left = leftSymbol(d, sym);
+    if (!visited[left]) d->symlen[left] = setSymlen(d, left, visited);
+    if (!visited[right]) d->symlen[right] = setSymlen(d, right, visited);
+    return d->symlen[left] + d->symlen[right] + 1;
+}
+
+const uint8_t* setSizes(PairsData* d, const uint8_t* data) {
+    d->flags = *data++;
+    
+    if (d->flags & SINGLE_VALUE) {
+        d->numBlocks = 0;
+        d->span = d->sparseIndexSize = 0;
+        d->minSymLen = *data++; // The single value
+        return data;
+    }
+    
+    // The last group multiplier is the number of positions
+    uint64_t tableSize = d->groupIdx[std::find(d->groupLen, d->groupLen + MAX_PIECES, 0) - d->groupLen];
+    
+    d->blockSize = size_t(1) << *data++;
+    d->span = size_t(1) << *data++;
+    d->sparseIndexSize = size_t((tableSize + d->span - 1) / d->span);
+    int padding = *data++;
+    d->numBlocks = readLE32(data);
+    data += 4;
+    d->blockLengthSize = d->numBlocks + padding;
+    d->maxSymLen = *data++;
+    d->minSymLen = *data++;
+    d->lowestSym = data;
+    d->base64.assign(d->maxSymLen - d->minSymLen + 1, 0);
+    
+    // Canonical Huffman code: longer codes have lower values. base64[i] is
+    // the lowest code of length minSymLen + i, left aligned in 64 bits, so
+    // a code's length is the first i with code >= base64[i].
+    for (int i = int(d->base64.size()) - 2; i >= 0; --i) {
+        d->base64[i] = (d->base64[i + 1] + readLE16(d->lowestSym + 2 * i)
+                        - readLE16(d->lowestSym + 2 * (i + 1))) / 2;
+    }
+    for (size_t i = 0; i < d->base64.size(); ++i) {
+        d->base64[i] <<= 64 - i - d->minSymLen;
+    }
+    
+    data += d->base64.size() * 2;
+    d->symlen.assign(readLE16(data), 0);
+    data += 2;
+    d->btree = data;
+    
+    std::vector<bool> visited(d->symlen.size());
+    for (size_t sym = 0; sym < d->symlen.size(); ++sym) {
+        if (!visited[sym]) d->symlen[sym] = setSymlen(d, int(sym), visited);
+    }
+    
+    return data + d->symlen.size() * 3 + (d->symlen.size() & 1);
+}
+
+// DTZ values are stored as ranks by frequency; the maps turn them back
+const uint8_t* setDtzMap(Table& t, const uint8_t* data, int maxFile) {
+    t.map = data;
+    
+    for (int f = 0; f <= maxFile; ++f) {
+        PairsData* d = t.get(0, f);
+        if (!(d->flags & MAPPED)) continue;
+        
+        if (d->flags & WIDE) {
+            data += uintptr_t(data) & 1;
+            for (int i = 0; i < 4; ++i) {
+                d->mapIdx[i] = uint16_t((data - t.map) / 2 + 1);
+                data += 2 * readLE16(data) + 2;
+            }
+        } else {
+            for (int i = 0; i < 4; ++i) {
+                d->mapIdx[i] = uint16_t(data - t.map + 1);
+                data += *data + 1;
+            }
+        }
+    }
+    
+    return data + (uintptr_t(data) & 1);
+}
+
+// Read the table layout from the mapped file
+void setup(Table& t, const uint8_t* data) {
+    data++; // Split and pawn flags, known from the name
+    
+    int sides = t.type == WDL && t.key != t.key2 ? 2 : 1;
+    int maxFile = t.hasPawns ? 3 : 0;
+    bool pawnsBothSides = t.hasPawns && t.pawnCount[1];
+    
+    for (int f = 0; f <= maxFile; ++f) {
+        for (int i = 0; i < sides; ++i) {
+            *t.get(i, f) = PairsData();
+        }
+        
+        int order[2][2] = {{*data & 0xF, pawnsBothSides ? *(data + 1) & 0xF : 0xF},
+                           {*data >> 4, pawnsBothSides ? *(data + 1) >> 4 : 0xF}};
+        data += 1 + pawnsBothSides;
+        
+        for (int k = 0; k < t.pieceCount; ++k, ++data) {
+            for (int i = 0; i < sides; ++i) {
+                t.get(i, f)->pieces[k] = i ? *data >> 4 : *data & 0xF;
+            }
+        }
+        
+        for (int i = 0; i < sides; ++i) {
+            setGroups(t, t.get(i, f), order[i], f);
+        }
+    }
+    
+    data += uintptr_t(data) & 1;
+    
+    for (int f = 0; f <= maxFile; ++f) {
+        for (int i = 0; i < sides; ++i) {
+            data = setSizes(t.get(i, f), data);
+        }
+    }
+    
+    if (t.type == DTZ) data = setDtzMap(t, data, maxFile);
+    
+    for (int f = 0; f <= maxFile; ++f) {
+        for (int i = 0; i < sides; ++i) {
+            PairsData* d = t.get(i, f);
+            d->sparseIndex = data;
+            data += d->sparseIndexSize * 6;
+        }
+    }
+    
+    for (int f = 0; f <= maxFile; ++f) {
+        for (int i = 0; i < sides; ++i) {
+            PairsData* d = t.get(i, f);
+            d->blockLength = data;
+            data += d->blockLengthSize * 2;
+        }
+    }
+    
+    for (int f = 0; f <= maxFile; ++f) {
+        for (int i = 0; i < sides; ++i) {
+            data = reinterpret_cast<const uint8_t*>((uintptr_t(data) + 0x3F) & ~uintptr_t(0x3F));
+            PairsData* d = t.get(i, f);
+            d->data = data;
+            data += d->numBlocks * d->blockSize;
+        }
+    }
+}
+
+// Map and set up the table on first use. False if its file is missing or
+// corrupt.
+bool ensureMapped(Table& t) {
+    static std::mutex mutex;
+    
+    if (t.ready.load(std::memory_order_acquire)) return t.base != nullptr;
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!t.ready.load(std::memory_order_relaxed)) {
+        const uint8_t* data = mapFile(t);
+        if (data) setup(t, data);
+        t.ready.store(true, std::memory_order_release);
+    }
+    return t.base != nullptr;
+}
+
+// Value at position idx of the table
+int decompressPairs(const PairsData* d, uint64_t idx) {
+    if (d->flags & SINGLE_VALUE) return d->minSymLen;
+    
+    // The sparse index gives the block and offset of every span-th value,
+    // counted from the middle of each span; walk from there to the block
+    // holding idx
+    uint32_t k = uint32_t(idx / d->span);
+    uint32_t block = readLE32(d->sparseIndex + 6 * k);
+    int offset = readLE16(d->sparseIndex + 6 * k + 4);
+    offset += int(idx % d->span) - int(d->span / 2);
+    
+    while (offset < 0) {
+        offset += readLE16(d->blockLength + 2 * --block) + 1;
+    }
+    while (offset > readLE16(d->blockLength + 2 * block)) {
+        offset -= readLE16(d->blockLength + 2 * block++) + 1;
+    }
+    
+    // Decode symbols from the start of the block until the one covering
+    // the offset
+    const uint8_t* ptr = d->data + uint64_t(block) * d->blockSize;
+    uint64_t buf64 = readBE64(ptr);
+    ptr += 8;
+    int buf64Size = 64;
+    int sym;
+    
+    while (true) {
+        int len = 0;
+        while (buf64 < d->base64[len]) ++len;
+        
+        sym = int((buf64 - d->base64[len]) >> (64 - len - d->minSymLen));
+        sym += readLE16(d->lowestSym + 2 * len);
+        
+        if (offset < d->symlen[sym] + 1) break;
+        
+        offset -= d->symlen[sym] + 1;
+        len += d->minSymLen;
+        buf64 <<= len;
+        buf64Size -= len;
+        
+        if (buf64Size <= 32) {
+            buf64Size += 32;
+            buf64 |= uint64_t(readBE32(ptr)) << (64 - buf64Size);
+            ptr += 4;
+        }
+    }
+    
+    // Expand the symbol's pairs down to the single value at the offset
+    while (d->symlen[sym]) {
+        int left = leftSymbol(d, sym);
+        if (offset < d->symlen[left] + 1) {
+            sym = left;
+        } else {
+            offset -= d->symlen[left] + 1;
+            sym = rightSymbol(d, sym);
+        }
+    }
+    
+    return leftSymbol(d, sym);
+}
+
+// A DTZ table covers one side to move only, except symmetric pawnless ones
+bool dtzCoversStm(Table& t, int stm, int file) {
+    int flags = t.get(0, file)->flags;
+    return (flags & STM) == stm || (t.key == t.key2 && !t.hasPawns);
+}
+
+int mapScore(Table& t, int file, int value, WDLScore wdl) {
+    if (t.type == WDL) return value - 2;
+    
+    static const int WDL_MAP[] = {1, 3, 0, 2, 0};
+    const PairsData* d = t.get(0, file);
+    
+    if (d->flags & MAPPED) {
+        int idx = d->mapIdx[WDL_MAP[wdl + 2]] + value;
+        value = d->flags & WIDE ? readLE16(t.map + 2 * idx) : t.map[idx];
+    }
+    
+    // Stored in moves or plies; we want plies
+    if ((wdl == WDL_WIN && !(d->flags & WIN_PLIES))
+        || (wdl == WDL_LOSS && !(d->flags & LOSS_PLIES))
+        || wdl == WDL_CURSED_WIN || wdl == WDL_BLESSED_LOSS) {
+        value *= 2;
+    }
+    
+    return value + 1;
+}
+
+// Index the position in the table and look up its value: WDL or DTZ
+int probeTable(const Board& board, Table& t, WDLScore wdl, ProbeState* result) {
+    Square squares[MAX_PIECES];
+    int pieces[MAX_PIECES];
+    int size = 0;
+    int leadPawnsCount = 0;
+    uint64_t leadPawns = 0;
+    int file = 0;
+    uint64_t idx;
+    
+    // Tables are stored with the stronger side white, and symmetric ones
+    // with white to move only; flip the colors and the board otherwise
+    bool symmetricBlackToMove = t.key == t.key2 && board.sideToMove() == BLACK;
+    bool blackStronger = materialKey(board) != t.key;
+    bool flip = symmetricBlackToMove || blackStronger;
+    int flipColor = flip ? 8 : 0;
+    int flipSquares = flip ? 56 : 0;
+    int stm = int(flip) ^ board.sideToMove();
+    
+    // With pawns, there is a table per file of the lead pawn, a-d
+    if (t.hasPawns) {
+        int pawn = t.get(0, 0)->pieces[0] ^ flipColor;
+        uint64_t b = leadPawns = board.pieces(pawn & 8 ? BLACK : WHITE, PAWN);
+        while (b) {
+            squares[size++] = popLsb(b) ^ flipSquares;
+        }
+        leadPawnsCount = size;
+        std::swap(squares[0], *std::max_element(squares, squares + leadPawnsCount, pawnsBefore));
+        file = fileOf(squares[0]);
+        if (file > 3) file = 7 - file;
+    }
+    
+    if (t.type == DTZ && !dtzCoversStm(t, stm, file)) {
+        *result = PROBE_CHANGE_STM;
+        return 0;
+    }
+    
+    uint64_t b = board.occupied() ^ leadPawns;
+    while (b) {
+        Square s = popLsb(b);
+        squares[size] = s ^ flipSquares;
+        pieces[size++] = tbPiece(board.pieceAt(s)) ^ flipColor;
+    }
+    
+    PairsData* d = t.get(stm, file);
+    
+    // Put the pieces in the table's encoding order
+    for (int i = leadPawnsCount; i < size - 1; ++i) {
+        for (int j = i + 1; j < size; ++j) {
+            if (d->pieces[i] == pieces[j]) {
+                std::swap(pieces[i], pieces[j]);
+                std::swap(squares[i], squares[j]);
+                break;
+            }
+        }
+    }
+    
+    // Mirror the lead piece onto files a-d
+    if (fileOf(squares[0]) > 3) {
+        for (int i = 0; i < size; ++i) squares[i] ^= 7;
+    }
+    
+    if (t.hasPawns) {
+        idx = leadPawnIdx[leadPawnsCount][squares[0]];
+        std::stable_sort(squares + 1, squares + leadPawnsCount, pawnsBefore);
+        for (int i = 1; i < leadPawnsCount; ++i) {
+            idx += binomial[i][mapPawns[squares[i]]];
+        }
+    } else {
+        // Without pawns, also onto ranks 1-4 and below the a1-h8 diagonal
+        if (rankOf(squares[0]) > 3) {
+            for (int i = 0; i < size; ++i) squares[i] ^= 56;
+        }
+        for (int i = 0; i < d->groupLen[0]; ++i) {
+            if (!offA1H8(squares[i])) continue;
+            if (offA1H8(squares[i]) > 0) {
+                for (int j = i; j < size; ++j) {
+                    squares[j] = ((squares[j] >> 3) | (squares[j] << 3)) & 63;
+                }
+            }
+            break;
+        }
+        
+        if (t.hasUniquePieces) {
+            // Three unique pieces together, by how many of them sit on the
+            // a1-h8 diagonal
+            int adjust1 = squares[1] > squares[0];
+            int adjust2 = (squares[2] > squares[0]) + (squares[2] > squares[1]);
+            
+            if (offA1H8(squares[0])) {
+                idx = (mapA1D1D4[squares[0]] * 63 + (squares[1] - adjust1)) * 62 + squares[2] - adjust2;
+            } else if (offA1H8(squares[1])) {
+                idx = (6 * 63 + rankOf(squares[0]) * 28 + mapB1H1H7[squares[1]]) * 62 + squares[2] - adjust2;
+            } else if (offA1H8(squares[2])) {
+                idx = 6 * 63 * 62 + 4 * 28 * 62 + rankOf(squares[0]) * 7 * 28
+                    + (rankOf(squares[1]) - adjust1) * 28 + mapB1H1H7[squares[2]];
+            } else {
+                idx = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 + rankOf(squares[0]) * 7 * 6
+                    + (rankOf(squares[1]) - adjust1) * 6 + (rankOf(squares[2]) - adjust2);
+            }
+        } else {
+            idx = mapKK[mapA1D1D4[squares[0]]][squares[1]];
+        }
+    }
+    
+    // The other groups: each as a combination of the squares left free by
+    // the groups before it (pawns only use the 48 pawn squares)
+    idx *= d->groupIdx[0];
+    Square* groupSq = squares + d->groupLen[0];
+    bool remainingPawns = t.hasPawns && t.pawnCount[1];
+    
+    for (int next = 1; d->groupLen[next]; ++next) {
+        std::stable_sort(groupSq, groupSq + d->groupLen[next]);
+        uint64_t n = 0;
+        
+        for (int i = 0; i < d->groupLen[next]; ++i) {
+            int adjust = int(std::count_if(squares, groupSq, [&](Square s) { return groupSq[i] > s; }));
+            n += binomial[i + 1][groupSq[i] - adjust - 8 * remainingPawns];
+        }
+        
+        remainingPawns = false;
+        idx += n * d->groupIdx[next];
+        groupSq += d->groupLen[next];
+    }
+    
+    return mapScore(t, file, decompressPairs(d, idx), wdl);
+}
+
+int probeTable(const Board& board, TableType type, WDLScore wdl, ProbeState* result) {
+    if (popcount(board.occupied()) == 2) return type == WDL ? WDL_DRAW : 0; // KvK
+    
+    auto it = tableIndex.find(materialKey(board));
+    if (it == tableIndex.end()) {
+        *result = PROBE_FAIL;
+        return 0;
+    }
+    
+    Table& t = type == WDL ? *it->second.wdl : *it->second.dtz;
+    if (!ensureMapped(t)) {
+        *result = PROBE_FAIL;
+        return 0;
+    }
+    return probeTable(board, t, wdl, result);
+}
+
+// The tables hold "don't care" values where the side to move has a winning
+// capture, and may hold a loss where a capture draws, to compress better.
+// So the captures (and for DTZ the pawn moves too) are searched, and the
+// best of their results and the stored one is the true value.
+WDLScore searchZeroing(Board& board, ProbeState* result, bool checkZeroingMoves) {
+    WDLScore bestValue = WDL_LOSS;
+    WDLScore value;
+    
+    MoveList moves;
+    DefaultMoveGenerator::generateLegalMoves(board, moves);
+    int moveCount = 0;
+    
+    for (Move m : moves) {
+        if (!MoveUtils::isCapture(m)
+            && (!checkZeroingMoves || typeOf(board.pieceAt(MoveUtils::from(m))) != PAWN)) {
+            continue;
+        }
+        moveCount++;
+        
+        board.makeMove(m);
+        value = WDLScore(-searchZeroing(board, result, false));
+        board.unmakeMove(m);
+        
+        if (*result == PROBE_FAIL) return WDL_DRAW;
+        
+        if (value > bestValue) {
+            bestValue = value;
+            if (value >= WDL_WIN) {
+                *result = PROBE_ZEROING_BEST_MOVE;
+                return value;
+            }
+        }
+    }
+    
+    // When every legal move was searched the table is not needed, and may
+    // be wrong, as it knows nothing of en passant rights
+    bool noMoreMoves = moveCount && moveCount == moves.size();
+    if (noMoreMoves) {
+        value = bestValue;
+    } else {
+        value = WDLScore(probeTable(board, WDL, WDL_DRAW, result));
+        if (*result == PROBE_FAIL) return WDL_DRAW;
+    }
+    
+    if (bestValue >= value) {
+        *result = bestValue > WDL_DRAW || noMoreMoves ? PROBE_ZEROING_BEST_MOVE : PROBE_OK;
+        return bestValue;
+    }
+    
+    *result = PROBE_OK;
+    return value;
+}
+
+bool canProbe(const Board& board) {
+    return largestTable > 0 && board.castlingRights() == 0
+        && popcount(board.occupied()) <= largestTable;
+}
+
+bool isMate(const Board& board) {
+    if (!board.checkers()) return false;
+    MoveList moves;
+    DefaultMoveGenerator::generateLegalMoves(board, moves);
+    return moves.empty();
+}
+
+// Root rank of a move that wins, or loses, within the fifty-move rule
+constexpr int MAX_DTZ = 1000;
+
+// Rank each root move by DTZ from the root, counting the fifty-move
+// counter: wins in time all alike, so the search picks among them, then
+// wins too slow for the rule by how close they come, draws, losses the
+// rule saves, and real losses
+bool rankByDTZ(Board& board, const std::vector<Move>& moves, std::vector<int>& ranks) {
+    int cnt50 = board.halfmoveClock();
+    ProbeState result = PROBE_OK;
+    
+    for (size_t i = 0; i < moves.size(); ++i) {
+        board.makeMove(moves[i]);
+        int dtz;
+        if (board.halfmoveClock() == 0) {
+            dtz = dtzBeforeZeroing(WDLScore(-probeWDL(board, &result)));
+        } else {
+            dtz = -probeDTZ(board, &result);
+            dtz = dtz > 0 ? dtz + 1 : dtz < 0 ? dtz - 1 : dtz;
+        }
+        board.unmakeMove(moves[i]);
+        
+        if (result == PROBE_FAIL) return false;
+        
+        ranks[i] = dtz > 0 ? (dtz + cnt50 <= 99 ? MAX_DTZ : std::max(1, MAX_DTZ - (dtz + cnt50)))
+                 : dtz < 0 ? (-dtz * 2 + cnt50 < 100 ? -MAX_DTZ : std::min(-1, -MAX_DTZ + (-dtz + cnt50)))
+                 : 0;
+    }
+    return true;
+}
+
+bool rankByWDL(Board& board, const std::vector<Move>& moves, std::vector<int>& ranks) {
+    static const int WDL_RANK[] = {-MAX_DTZ, -899, 0, 899, MAX_DTZ};
+    ProbeState result = PROBE_OK;
+    
+    for (size_t i = 0; i < moves.size(); ++i) {
+        board.makeMove(moves[i]);
+        WDLScore wdl = WDLScore(-probeWDL(board, &result));
+        board.unmakeMove(moves[i]);
+        
+        if (result == PROBE_FAIL) return false;
+        ranks[i] = WDL_RANK[wdl + 2];
+    }
+    return true;
+}
+
+}
+
+void init(const std::string& paths) {
+    tableIndex.clear();
+    tables.clear();
+    directories.clear();
+    largestTable = 0;
+    
+    if (paths.empty() || paths == "<empty>") return;
+    
+    std::stringstream ss(paths);
+    std::string dir;
+    while (std::getline(ss, dir, ':')) {
+        if (!dir.empty()) directories.push_back(dir);
+    }
+    
+    // mapB1H1H7: squares below the a1-h8 diagonal, 0-27
+    int code = 0;
+    for (Square s = 0; s < 64; ++s) {
+        if (offA1H8(s) < 0) mapB1H1H7[s] = code++;
+    }
+    
+    // mapA1D1D4: the a1-d1-d4 triangle, 0-9, diagonal squares last
+    std::vector<Square> diagonal;
+    code = 0;
+    for (Square s = 0; s <= 27; ++s) {
+        if (fileOf(s) > 3) continue;
+        if (offA1H8(s) < 0) {
+            mapA1D1D4[s] = code++;
+        } else if (offA1H8(s) == 0) {
+            diagonal.push_back(s);
+        }
+    }
+    for (Square s : diagonal) mapA1D1D4[s] = code++;
+    
+    // mapKK: the 462 legal king pairs with the first king in the triangle,
+    // and the second not above the diagonal when the first is on it. Pairs
+    // with both on the diagonal come last.
+    std::vector<std::pair<int, Square>> bothOnDiagonal;
+    code = 0;
+    for (int idx = 0; idx < 10; ++idx) {
+        for (Square s1 = 0; s1 <= 27; ++s1) {
+            if (fileOf(s1) > 3 || offA1H8(s1) > 0) continue;
+            if (mapA1D1D4[s1] != idx || (!idx && s1 != B1)) continue;
+            
+            for (Square s2 = 0; s2 < 64; ++s2) {
+                if (s1 == s2 || (Attacks::getKingAttacks(s1) & Attacks::squareBB(s2))) continue;
+                if (!offA1H8(s1) && offA1H8(s2) > 0) continue;
+                if (!offA1H8(s1) && !offA1H8(s2)) {
+                    bothOnDiagonal.emplace_back(idx, s2);
+                } else {
+                    mapKK[idx][s2] = code++;
+                }
+            }
+        }
+    }
+    for (const auto& p : bothOnDiagonal) mapKK[p.first][p.second] = code++;
+    
+    // Pascal's triangle
+    binomial[0][0] = 1;
+    for (int n = 1; n < 64; ++n) {
+        for (int k = 0; k < MAX_PIECES && k <= n; ++k) {
+            binomial[k][n] = (k > 0 ? binomial[k - 1][n - 1] : 0) + (k < n ? binomial[k][n - 1] : 0);
+        }
+    }
+    
+    // mapPawns: a2-h7 by lead pawn preference, 47 down to 0, and the index
+    // of each lead pawn square within its file's table
+    int availableSquares = 47;
+    for (int leadPawnsCount = 1; leadPawnsCount <= 5; ++leadPawnsCount) {
+        for (int f = 0; f < 4; ++f) {
+            uint64_t idx = 0;
+            for (int r = 1; r <= 6; ++r) {
+                Square s = makeSquare(f, r);
+                if (leadPawnsCount == 1) {
+                    mapPawns[s] = availableSquares--;
+                    mapPawns[s ^ 7] = availableSquares--;
+                }
+                leadPawnIdx[leadPawnsCount][s] = idx;
+                idx += binomial[leadPawnsCount - 1][mapPawns[s]];
+            }
+            leadPawnsSize[leadPawnsCount][f] = idx;
+        }
+    }
+    
+    // Every material signature with up to seven pieces, stronger side
+    // first and pieces in descending order
+    auto add = [](std::initializer_list<PieceType> white, std::initializer_list<PieceType> black) {
+        std::string name = "K";
+        for (PieceType pt : white) name += PIECE_CHARS[pt];
+        name += 'K';
+        for (PieceType pt : black) name += PIECE_CHARS[pt];
+        addTable(name);
+    };
+    
+    for (PieceType p1 = QUEEN; p1 >= PAWN; --p1) {
+        add({p1}, {});
+        for (PieceType p2 = p1; p2 >= PAWN; --p2) {
+            add({p1, p2}, {});
+            add({p1}, {p2});
+            for (PieceType p3 = QUEEN; p3 >= PAWN; --p3) {
+                add({p1, p2}, {p3});
+            }
+            for (PieceType p3 = p2; p3 >= PAWN; --p3) {
+                add({p1, p2, p3}, {});
+                for (PieceType p4 = p3; p4 >= PAWN; --p4) {
+                    add({p1, p2, p3, p4}, {});
+                    for (PieceType p5 = p4; p5 >= PAWN; --p5) {
+                        add({p1, p2, p3, p4, p5}, {});
+                    }
+                    for (PieceType p5 = QUEEN; p5 >= PAWN; --p5) {
+                        add({p1, p2, p3, p4}, {p5});
+                    }
+                }
+                for (PieceType p4 = QUEEN; p4 >= PAWN; --p4) {
+                    add({p1, p2, p3}, {p4});
+                    for (PieceType p5 = p4; p5 >= PAWN; --p5) {
+                        add({p1, p2, p3}, {p4, p5});
+                    }
+                }
+            }
+            for (PieceType p3 = p1; p3 >= PAWN; --p3) {
+                for (PieceType p4 = (p1 == p3 ? p2 : p3); p4 >= PAWN; --p4) {
+                    add({p1, p2}, {p3, p4});
+                }
+            }
+        }
+    }
+}
+
+int maxPieces() {
+    return largestTable;
+}
+
+WDLScore probeWDL(Board& board, ProbeState* result) {
+    *result = PROBE_OK;
+    return searchZeroing(board, result, false);
+}
+
+int probeDTZ(Board& board, ProbeState* result) {
+    *result = PROBE_OK;
+    WDLScore wdl = searchZeroing(board, result, true);
+    
+    // DTZ tables store no draws
+    if (*result == PROBE_FAIL || wdl == WDL_DRAW) return 0;
+    
+    if (*result == PROBE_ZEROING_BEST_MOVE) return dtzBeforeZeroing(wdl);
+    
+    int dtz = probeTable(board, DTZ, wdl, result);
+    if (*result == PROBE_FAIL) return 0;
+    
+    if (*result != PROBE_CHANGE_STM) {
+        return (dtz + 100 * (wdl == WDL_BLESSED_LOSS || wdl == WDL_CURSED_WIN)) * signOf(wdl);
+    }
+    
+    // The table stores the other side to move: take the best reply's DTZ
+    int minDTZ = 0xFFFF;
+    MoveList moves;
+    DefaultMoveGenerator::generateLegalMoves(board, moves);
+    
+    for (Move m : moves) {
+        bool zeroing = MoveUtils::isCapture(m) || typeOf(board.pieceAt(MoveUtils::from(m))) == PAWN;
+        
+        board.makeMove(m);
+        dtz = zeroing ? -dtzBeforeZeroing(searchZeroing(board, result, false))
+                      : -probeDTZ(board, result);
+        if (dtz == 1 && isMate(board)) minDTZ = 1;
+        if (!zeroing) dtz += signOf(dtz);
+        if (dtz < minDTZ && signOf(dtz) == signOf(wdl)) minDTZ = dtz;
+        board.unmakeMove(m);
+        
+        if (*result == PROBE_FAIL) return 0;
+    }
+    
+    // No legal moves: mated
+    return minDTZ == 0xFFFF ? -1 : minDTZ;
+}
+
+bool filterRootMoves(Board& board, std::vector<Move>& moves, WDLScore& score) {
+    if (moves.empty() || !canProbe(board)) return false;
+    
+    std::vector<int> ranks(moves.size());
+    if (!rankByDTZ(board, moves, ranks) && !rankByWDL(board, moves, ranks)) return false;
+    
+    int best = *std::max_element(ranks.begin(), ranks.end());
+    std::vector<Move> kept;
+    for (size_t i = 0; i < moves.size(); ++i) {
+        if (ranks[i] == best) kept.push_back(moves[i]);
+    }
+    moves = kept;
+    
+    score = best > 900 ? WDL_WIN : best > 0 ? WDL_CURSED_WIN : best == 0 ? WDL_DRAW
+          : best > -MAX_DTZ ? WDL_BLESSED_LOSS : WDL_LOSS;
+    return true;
+}
+
+}
@@ -0,0 +1,61 @@
+#ifndef SYZYGY_H
+#define SYZYGY_H
+
+#include "types.h"
+#include "move.h"
+#include "board.h"
+#include <string>
+#include <vector>
+
+// Syzygy endgame tablebase probing, for up to seven pieces.
+//
+// The .rtbw (win/draw/loss) and .rtbz (distance to zeroing move) files are
+// found at init, and each is memory mapped read-only on first use, so all
+// engine processes on a host share one copy in the page cache. Probing is
+// thread safe.
+namespace Syzygy {
+
+constexpr int MAX_PIECES = 7;
+
+// Outcome with the fifty-move rule: a cursed win is a win only without it,
+// a blessed loss is a loss only without it
+enum WDLScore {
+    WDL_LOSS = -2,
+    WDL_BLESSED_LOSS = -1,
+    WDL_DRAW = 0,
+    WDL_CURSED_WIN = 1,
+    WDL_WIN = 2
+};
+
+enum ProbeState {
+    PROBE_FAIL = 0,               // Table missing or position not covered
+    PROBE_OK = 1,
+    PROBE_CHANGE_STM = -1,        // DTZ table stores the other side to move
+    PROBE_ZEROING_BEST_MOVE = 2   // Best move captures or moves a pawn
+};
+
+// Find the tables in the given directories, separated by ':'. An empty
+// string or "<empty>" unloads them. Not to be called during a search.
+void init(const std::string& paths);
+
+// Most pieces of any table found, 0 for none
+int maxPieces();
+
+// Probes of positions without castling rights and at most maxPieces()
+// pieces. The board is used for move making but left unchanged.
+WDLScore probeWDL(Board& board, ProbeState* result);
+
+// Plies to the next capture or pawn move with best play, negative when
+// losing; 100 is added for cursed wins and blessed losses
+int probeDTZ(Board& board, ProbeState* result);
+
+// Reduce the root moves to those that keep the best result reachable
+// under the fifty-move rule, ranked by DTZ, falling back to WDL when DTZ
+// tables are missing. Every move winning within the rule is kept, so the
+// search still chooses among them. Returns false if the root cannot be probed; on
+// success score is set to the outcome from the side to move's view.
+bool filterRootMoves(Board& board, std::vector<Move>& moves, WDLScore& score);
+
+}
+
+#endif // SYZYGY_H
@@ -0,0 +1,184 @@
+#include "thread.h"
+#include "movegen_fast.h"
+#include "numa.h"
+#include <algorithm>
+#include <chrono>
+
+ThreadPool::ThreadPool() {
+    setThreadCount(1);
+}
+
+ThreadPool::~ThreadPool() {
+    stopHelpers();
+}
+
+void ThreadPool::setThreadCount(int count) {
+    stopHelpers();
+    searches.clear();
+    
+    for (int i = 0; i < count; ++i) {
+        searches.push_back(std::make_unique<Search>(*this, i));
+    }
+    
+    exiting = false;
+    for (int i = 1; i < count; ++i) {
+        helpers.emplace_back(&ThreadPool::helperLoop, this, i, generation);
+    }
+}
+
+void ThreadPool::stopHelpers() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        exiting = true;
+    }
+    wake.notify_all();
+    for (std::thread& t : helpers) {
+        t.join();
+    }
+    helpers.clear();
+}
+
+Move ThreadPool::think(const Board& board, const SearchLimits& limits) {
+    Numa::bindThread(0);
+    stop = false;
+    stopOnPonderhit = false;
+    tt.newSearch();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        rootBoard = board;
+        searchLimits = limits;
+        running = int(helpers.size());
+        generation++;
+    }
+    wake.notify_all();
+    
+    searches[0]->think(board, limits);
+    
+    // A ponder search may not answer before the GUI says ponderhit or stop,
+    // even when it ended early on its depth limit or a mate
+    while (pondering && !stop) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    
+    // The main thread decides when the search ends; helpers still deepening
+    // are cut off here
+    stop = true;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return running == 0; });
+    }
+    
+    Move best = pickBestMove();
+    lastPonderMove = findPonderMove(board, best);
+    return best;
+}
+
+void ThreadPool::ponderHit() {
+    if (stopOnPonderhit) stop = true;
+    pondering = false;
+}
+
+void ThreadPool::helperLoop(int id, uint64_t seen) {
+    Numa::bindThread(id);
+    
+    while (true) {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [&] { return exiting || generation != seen; });
+        if (exiting) return;
+        seen = generation;
+        lock.unlock();
+        
+        searches[id]->think(rootBoard, searchLimits);
+        
+        lock.lock();
+        if (--running == 0) {
+            done.notify_all();
+        }
+    }
+}
+
+uint64_t ThreadPool::nodesSearched() const {
+    uint64_t nodes = 0;
+    for (const auto& s : searches) {
+        nodes += s->getInfo().nodes.load(std::memory_order_relaxed);
+    }
+    return nodes;
+}
+
+uint64_t ThreadPool::tbHitsSearched() const {
+    uint64_t hits = 0;
+    for (const auto& s : searches) {
+        hits += s->getInfo().tbHits.load(std::memory_order_relaxed);
+    }
+    return hits;
+}
+
+void ThreadPool::clear() {
+    tt.clear(size());
+    clearHistory();
+}
+
+void ThreadPool::clearHistory() {
+    for (auto& search : searches) {
+        search->clearHistory();
+    }
+}
+
+// Each thread votes for its best move, weighted by its score relative to
+// the worst thread and by the depth it completed. Ties go to the thread
+// found first, so the main thread wins unless outvoted. With several
+// lines reported, the answer is the first of them.
+Move ThreadPool::pickBestMove() const {
+    const SearchInfo& main = searches[0]->getInfo();
+    if (searches.size() == 1 || searchLimits.multiPV > 1) return main.bestMove;
+    
+    Score minScore = main.score;
+    for (const auto& s : searches) {
+        if (s->getInfo().bestMove) minScore = std::min(minScore, s->getInfo().score);
+    }
+    
+    auto votesFor = [&](Move m) {
+        int64_t votes = 0;
+        for (const auto& s : searches) {
+            const SearchInfo& info = s->getInfo();
+            if (info.bestMove == m) {
+                votes += int64_t(info.score - minScore + 14) * info.completedDepth;
+            }
+        }
+        return votes;
+    };
+    
+    Move best = main.bestMove;
+    int64_t bestVotes = best ? votesFor(best) : -1;
+    for (const auto& s : searches) {
+        Move m = s->getInfo().bestMove;
+        if (!m || s->getInfo().completedDepth == 0) continue;
+        int64_t votes = votesFor(m);
+        if (votes > bestVotes) {
+            best = m;
+            bestVotes = votes;
+        }
+    }
+    return best;
+}
+
+Move ThreadPool::findPonderMove(const Board& board, Move best) const {
+    if (!best) return 0;
+    for (const auto& s : searches) {
+        const SearchInfo& info = s->getInfo();
+        if (info.bestMove == best && info.pv.size() > 1) return info.pv[1];
+    }
+    
+    // A PV cut short at the root: take the TT move of the position after
+    // the best move, if it is legal there
+    Board next = board;
+    next.makeMove(best);
+    TTEntry entry;
+    if (!tt.probe(next.getHash(), entry) || !entry.bestMove) return 0;
+    MoveList legal;
+    DefaultMoveGenerator::generateLegalMoves(next, legal);
+    for (Move m : legal) {
+        if (m == entry.bestMove) return m;
+    }
+    return 0;
+}
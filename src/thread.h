@@ -0,0 +1,83 @@
+#ifndef THREAD_H
+#define THREAD_H
+
+#include "types.h"
+#include "board.h"
+#include "search.h"
+#include "tt.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Lazy SMP thread pool. Every thread runs its own iterative deepening on a
+// private board copy; they cooperate only through the shared transposition
+// table. Helper threads are created once and sleep between searches.
+class ThreadPool {
+public:
+    ThreadPool();
+    ~ThreadPool();
+    
+    // Not to be called while a search is running
+    void setThreadCount(int count);
+    int size() const { return int(searches.size()); }
+    
+    // Search on the calling thread as the main thread with the helpers in
+    // parallel. Returns the voted best move once every thread has stopped.
+    Move think(const Board& board, const SearchLimits& limits);
+    
+    void stopSearch() { stop = true; }
+    
+    // The opponent played the expected move: the ponder search goes on as
+    // a normal one, or stops now if its time was already used up
+    void ponderHit();
+    
+    // Expected reply to the last best move, from the PV or the TT; 0 if none
+    Move ponderMove() const { return lastPonderMove; }
+    
+    // Main thread results of the last search, such as its score
+    const SearchInfo& mainInfo() const { return searches[0]->getInfo(); }
+    
+    // Nodes summed over all threads
+    uint64_t nodesSearched() const;
+    uint64_t tbHitsSearched() const;
+    
+    // Forget everything learned from previous searches (ucinewgame)
+    void clear();
+    
+    // Forget the move ordering history only, keeping the hash table
+    void clearHistory();
+    
+    TranspositionTable tt;
+    std::atomic<bool> stop{false};
+    std::atomic<bool> pondering{false};      // Set before a go ponder search starts
+    std::atomic<bool> stopOnPonderhit{false}; // Time ran out while pondering
+    bool silent = false; // No info lines from the main thread (bench)
+    SearchParams params; // Not to be changed while a search is running
+
+private:
+    std::vector<std::unique_ptr<Search>> searches; // searches[0] is the main thread
+    std::vector<std::thread> helpers;              // helpers[i] runs searches[i + 1]
+    
+    // Current search, handed to the helpers under the mutex
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    uint64_t generation = 0;
+    int running = 0;
+    bool exiting = false;
+    Board rootBoard;
+    SearchLimits searchLimits;
+    Move lastPonderMove = 0;
+    
+    // seen is the generation at creation, so a new helper waits for the
+    // next search instead of replaying the last one
+    void helperLoop(int id, uint64_t seen);
+    void stopHelpers();
+    Move pickBestMove() const;
+    Move findPonderMove(const Board& board, Move best) const;
+};
+
+#endif // THREAD_H
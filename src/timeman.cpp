@@ -0,0 +1,74 @@
+#include "timeman.h"
+#include <algorithm>
+
+// Moves assumed left in the game when the GUI does not say
+constexpr int DEFAULT_MOVES_TO_GO = 40;
+
+// Soft limit scaling after an iteration
+constexpr int MAX_STABILITY = 8;
+constexpr double UNSTABLE_FACTOR = 1.6;    // A best move that just changed
+constexpr double STABILITY_STEP = 0.1;     // Less for each stable iteration
+constexpr Score SCORE_DROP_CAP = 150;       // Centipawns
+constexpr double SCORE_DROP_FACTOR = 0.6;   // Extra share for a full drop
+
+// The hard limit is a multiple of the soft limit, but never more than
+// this share of the clock
+constexpr int64_t HARD_TO_SOFT = 5;
+constexpr double HARD_CLOCK_SHARE = 0.8;
+
+void TimeManager::init(const SearchLimits& limits, Color us) {
+    startTime = limits.startTime;
+    soft = hard = 0;
+    fixedTime = false;
+    lastBestMove = 0;
+    lastScore = 0;
+    stability = 0;
+    
+    if (limits.infinite) return;
+    
+    if (limits.moveTime > 0) {
+        soft = hard = std::max<int64_t>(1, limits.moveTime - limits.moveOverhead);
+        fixedTime = true;
+        return;
+    }
+    
+    int64_t time = limits.time[us];
+    if (time <= 0) return;
+    
+    // Spread the clock and the increments still to come over the moves to
+    // go, keeping the overhead of each of them in reserve
+    int movesToGo = limits.movesToGo > 0 ? std::min(limits.movesToGo, 50) : DEFAULT_MOVES_TO_GO;
+    int64_t available = time + limits.inc[us] * (movesToGo - 1)
+                      - limits.moveOverhead * (movesToGo + 2);
+    soft = std::max<int64_t>(1, available / movesToGo);
+    
+    hard = std::min<int64_t>(soft * HARD_TO_SOFT, int64_t(time * HARD_CLOCK_SHARE) - limits.moveOverhead);
+    hard = std::max<int64_t>(1, hard);
+    soft = std::min(soft, hard);
+}
+
+int64_t TimeManager::elapsed() const {
+    auto elapsed = std::chrono::steady_clock::now() - startTime;
+    return std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+}
+
+bool TimeManager::stopAfterIteration(Move bestMove, Score score, double bestMoveEffort) {
+    if (!enabled()) return false;
+    
+    // A fixed move time is used in full
+    if (fixedTime) return elapsed() >= hard;
+    
+    Score drop = lastBestMove ? lastScore - score : 0;
+    stability = bestMove == lastBestMove ? std::min(stability + 1, MAX_STABILITY) : 0;
+    lastBestMove = bestMove;
+    lastScore = score;
+    
+    // Stop sooner when the best move keeps winning and takes most of the
+    // effort; go on longer when it changes or the score is falling
+    double stabilityFactor = UNSTABLE_FACTOR - STABILITY_STEP * stability;
+    double scoreFactor = 1.0 + SCORE_DROP_FACTOR * std::clamp(drop, 0, SCORE_DROP_CAP) / SCORE_DROP_CAP;
+    double effortFactor = std::max(0.5, 1.75 - 1.25 * bestMoveEffort);
+    
+    double target = soft * stabilityFactor * scoreFactor * effortFactor;
+    return elapsed() >= std::min<double>(target, hard);
+}
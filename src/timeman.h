@@ -0,0 +1,55 @@
+#ifndef TIMEMAN_H
+#define TIMEMAN_H
+
+#include "types.h"
+#include "move.h"
+#include <chrono>
+#include <cstdint>
+
+// What a "go" command asks for. Times are in milliseconds.
+struct SearchLimits {
+    int depth = 64;
+    int64_t time[2] = {0, 0}; // Remaining clock, by color
+    int64_t inc[2] = {0, 0};
+    int movesToGo = 0;        // 0 for sudden death
+    int64_t moveTime = 0;     // Fixed time for this move
+    uint64_t nodes = 0;       // Node limit over all threads, 0 for none
+    bool infinite = false;
+    int moveOverhead = 30;    // Lost per move to the GUI and the OS
+    int multiPV = 1;          // Best root moves to search and report
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+};
+
+// Time allocation for one search on the main thread.
+//
+// The soft limit is the time a typical move should take. After each
+// iteration it is scaled by how stable the best move has been, by how far
+// the score dropped and by the share of nodes the best move took, and the
+// search stops once that is used up. The hard limit is never exceeded: it
+// stops the search in the middle of an iteration.
+class TimeManager {
+public:
+    void init(const SearchLimits& limits, Color us);
+    
+    // Whether the clock limits this search at all
+    bool enabled() const { return hard > 0; }
+    int64_t elapsed() const;
+    int64_t softLimit() const { return soft; }
+    int64_t hardLimit() const { return hard; }
+    
+    // After a completed iteration: whether to stop rather than go deeper.
+    // bestMoveEffort is the fraction of all nodes spent below the best move.
+    bool stopAfterIteration(Move bestMove, Score score, double bestMoveEffort);
+
+private:
+    std::chrono::steady_clock::time_point startTime;
+    int64_t soft = 0;
+    int64_t hard = 0;
+    bool fixedTime = false;
+    
+    Move lastBestMove = 0;
+    Score lastScore = 0;
+    int stability = 0; // Iterations in a row with the same best move
+};
+
+#endif // TIMEMAN_H
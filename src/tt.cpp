@@ -0,0 +1,163 @@
+#include "tt.h"
+#include "large_pages.h"
+#include "numa.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <vector>
+
+// Slot layout: bits 0-15 key fragment, 16-31 move, 32-47 score, 48-55
+// depth + 1 (0 marks an empty slot), 56-57 type, 58-63 search generation
+static inline uint64_t packEntry(uint64_t hash, Move m, Score score, int depth, TTEntry::Type type,
+                                 unsigned age) {
+    return uint64_t(uint16_t(hash))
+         | uint64_t(uint16_t(m)) << 16
+         | uint64_t(uint16_t(int16_t(score))) << 32
+         | uint64_t(uint8_t(depth + 1)) << 48
+         | uint64_t(type) << 56
+         | uint64_t(age) << 58;
+}
+
+static inline bool entryMatches(uint64_t data, uint64_t hash) {
+    return uint16_t(data) == uint16_t(hash) && (data >> 48 & 0xFF) != 0;
+}
+
+static inline Move entryMove(uint64_t data) {
+    return Move(uint16_t(data >> 16));
+}
+
+static inline int entryDepth(uint64_t data) {
+    return int(data >> 48 & 0xFF) - 1;
+}
+
+static inline unsigned entryAge(uint64_t data) {
+    return (data >> 58) & 0x3F;
+}
+
+TranspositionTable::TranspositionTable() {
+    resize(DEFAULT_MB);
+}
+
+TranspositionTable::~TranspositionTable() {
+    LargePages::release(buckets, bucketCount * sizeof(Bucket));
+}
+
+size_t TranspositionTable::resize(size_t megabytes, int threads) {
+    LargePages::release(buckets, bucketCount * sizeof(Bucket));
+    buckets = nullptr;
+    bucketCount = 0;
+    
+    // Failing the full size, try the powers of two below it
+    size_t size = std::max<size_t>(1, megabytes);
+    while (true) {
+        size_t count = std::max<size_t>(1, size * 1024 * 1024 / sizeof(Bucket));
+        buckets = static_cast<Bucket*>(LargePages::allocate(count * sizeof(Bucket)));
+        if (buckets) {
+            bucketCount = count;
+            break;
+        }
+        if (size == 1) {
+            throw std::bad_alloc();
+        }
+        size_t lower = 1;
+        while (lower * 2 < size) lower *= 2;
+        size = lower;
+    }
+    clear(threads);
+    return size;
+}
+
+void TranspositionTable::clear(int threads) {
+    generation = 0;
+    
+    // An all-zero slot has depth byte 0 and never matches
+    auto clearRange = [this](size_t begin, size_t end) {
+        std::memset(static_cast<void*>(buckets + begin), 0, (end - begin) * sizeof(Bucket));
+    };
+    
+    if (threads <= 1) {
+        clearRange(0, bucketCount);
+        return;
+    }
+    
+    // Fresh pages are placed on the node of the thread that first writes
+    // them, so with NumaBind the table ends up spread over the nodes
+    std::vector<std::thread> workers;
+    size_t chunk = (bucketCount + threads - 1) / threads;
+    for (int i = 0; i < threads; ++i) {
+        size_t begin = std::min(bucketCount, i * chunk);
+        size_t end = std::min(bucketCount, begin + chunk);
+        workers.emplace_back([=] {
+            Numa::bindThread(i);
+            clearRange(begin, end);
+        });
+    }
+    for (std::thread& t : workers) {
+        t.join();
+    }
+}
+
+bool TranspositionTable::probe(uint64_t hash, TTEntry& entry) const {
+    const Bucket& bucket = buckets[bucketIndex(hash)];
+    
+    for (const Slot& slot : bucket.slots) {
+        uint64_t data = slot.load(std::memory_order_relaxed);
+        if (!entryMatches(data, hash)) {
+            continue;
+        }
+        
+        entry.bestMove = entryMove(data);
+        entry.score = int16_t(data >> 32);
+        entry.depth = entryDepth(data);
+        entry.type = TTEntry::Type((data >> 56) & 3);
+        return true;
+    }
+    return false;
+}
+
+void TranspositionTable::store(uint64_t hash, Move m, Score score, int depth, TTEntry::Type type) {
+    Bucket& bucket = buckets[bucketIndex(hash)];
+    Slot* replace = &bucket.slots[0];
+    int replaceValue = 1 << 30;
+    
+    for (Slot& slot : bucket.slots) {
+        uint64_t data = slot.load(std::memory_order_relaxed);
+        
+        // Same position: keep a deeper bound from this search, and keep the
+        // old move if the new result has none
+        if (entryMatches(data, hash)) {
+            if (type != TTEntry::EXACT && entryAge(data) == generation && depth + 4 < entryDepth(data)) {
+                return;
+            }
+            if (m == 0) m = entryMove(data);
+            replace = &slot;
+            break;
+        }
+        
+        // Otherwise evict the shallowest entry, counting each search
+        // generation of age as 8 plies of depth; empty slots go first
+        int age = (generation - entryAge(data)) & AGE_MASK;
+        int value = data ? entryDepth(data) - 8 * age : -(1 << 20);
+        if (value < replaceValue) {
+            replaceValue = value;
+            replace = &slot;
+        }
+    }
+    
+    replace->store(packEntry(hash, m, score, depth, type, generation), std::memory_order_relaxed);
+}
+
+int TranspositionTable::hashfull() const {
+    size_t sample = std::min<size_t>(1000 / SLOTS_PER_BUCKET, bucketCount);
+    int used = 0;
+    for (size_t i = 0; i < sample; ++i) {
+        for (const Slot& slot : buckets[i].slots) {
+            uint64_t data = slot.load(std::memory_order_relaxed);
+            if (data && entryAge(data) == generation) {
+                used++;
+            }
+        }
+    }
+    return int(used * 1000 / (sample * SLOTS_PER_BUCKET));
+}
@@ -0,0 +1,84 @@
+#ifndef TT_H
+#define TT_H
+
+#include "types.h"
+#include <atomic>
+#include <cstddef>
+
+// Decoded transposition table entry
+struct TTEntry {
+    enum Type : uint8_t { EXACT, LOWER, UPPER };
+    
+    Move bestMove;
+    Score score;
+    int depth;
+    Type type;
+};
+
+// Transposition table shared by all search threads, sized in megabytes.
+// Each 64-byte bucket holds eight 8-byte slots, so a probe touches one
+// cache line. A slot packs a 16-bit key fragment with the move, score,
+// depth, bound and age into one atomic word: writes are lock-free and a
+// slot can never be torn between two writers. The bucket index comes from
+// the high bits of the hash and the fragment from the low ones, so a false
+// match needs both to collide; moves read back are always validated
+// before use.
+class TranspositionTable {
+public:
+    static constexpr size_t DEFAULT_MB = 64;
+    
+    TranspositionTable();
+    ~TranspositionTable();
+    
+    TranspositionTable(const TranspositionTable&) = delete;
+    TranspositionTable& operator=(const TranspositionTable&) = delete;
+    
+    // Reallocate the table in large pages and clear it over the given
+    // number of threads; the contents are lost. If the full size cannot be
+    // had, the largest smaller power of two that can is used. Returns the
+    // size allocated in megabytes; throws std::bad_alloc only if not even
+    // 1 MB is available.
+    size_t resize(size_t megabytes, int threads = 1);
+    
+    // Zero the table, splitting the work over the given number of threads
+    void clear(int threads = 1);
+    
+    // Start a new search generation, which ages every stored entry
+    void newSearch() { generation = (generation + 1) & AGE_MASK; }
+    
+    // Fill entry and return true if the table holds data for this hash
+    bool probe(uint64_t hash, TTEntry& entry) const;
+    
+    // Store into the bucket, replacing the same position or else the
+    // shallowest, oldest slot
+    void store(uint64_t hash, Move m, Score score, int depth, TTEntry::Type type);
+    
+    // Start loading the bucket for a position that is about to be probed
+    void prefetch(uint64_t hash) const { __builtin_prefetch(&buckets[bucketIndex(hash)]); }
+    
+    // Permille of sampled slots written during the current search
+    int hashfull() const;
+
+private:
+    // key | move | score | depth + 1 | type | age; all zero when empty
+    using Slot = std::atomic<uint64_t>;
+    
+    static constexpr int SLOTS_PER_BUCKET = 8;
+    struct alignas(64) Bucket {
+        Slot slots[SLOTS_PER_BUCKET];
+    };
+    static_assert(sizeof(Bucket) == 64, "Bucket must fill one cache line");
+    
+    static constexpr unsigned AGE_MASK = 0x3F;
+    
+    Bucket* buckets = nullptr;
+    size_t bucketCount = 0;
+    unsigned generation = 0;
+    
+    // Map the hash onto [0, bucketCount) without requiring a power of two
+    size_t bucketIndex(uint64_t hash) const {
+        return size_t((unsigned __int128)hash * bucketCount >> 64);
+    }
+};
+
+#endif // TT_H
@@ -0,0 +1,440 @@
+#include "tune.h"
+
+#ifdef TUNE
+
+#include "board.h"
+#include "evaluation.h"
+#include "pawns.h"
+#include "psqt.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace Tune {
+
+thread_local Trace trace;
+
+// Layout of the parameter vector. Piece-square tables are in source order,
+// from White's side with rank 8 first.
+enum Param {
+    MATERIAL = 0,              // Pawn to queen
+    PST = MATERIAL + 5,        // Pawn to queen, one table for both phases
+    KING_MG = PST + 5 * 64,
+    KING_EG = KING_MG + 64,
+    DOUBLED = KING_EG + 64,    // Middlegame and endgame pairs
+    ISOLATED = DOUBLED + 2,
+    BACKWARD = ISOLATED + 2,
+    PASSED_MG = BACKWARD + 2,
+    PASSED_EG = PASSED_MG + 8,
+    SHELTER = PASSED_EG + 8,
+    KING_EXPOSED = SHELTER + 4,
+    PARAM_NB = KING_EXPOSED + 1
+};
+
+// How the game phase scales a term: not at all, or as a middlegame or an
+// endgame value
+enum Taper : uint8_t { FLAT, MIDGAME, ENDGAME };
+
+static Taper taperOf(int param) {
+    if (param >= KING_MG && param < KING_EG) return MIDGAME;
+    if (param >= KING_EG && param < DOUBLED) return ENDGAME;
+    if (param >= DOUBLED && param < PASSED_MG) return (param - DOUBLED) % 2 == 0 ? MIDGAME : ENDGAME;
+    if (param >= PASSED_MG && param < PASSED_EG) return MIDGAME;
+    if (param >= PASSED_EG && param < SHELTER) return ENDGAME;
+    if (param >= SHELTER) return MIDGAME;
+    return FLAT;
+}
+
+static Taper tapers[PARAM_NB];
+
+// One term of a position and how often it counts for White
+struct Feature {
+    uint16_t param;
+    int16_t count;
+};
+
+struct Position {
+    uint32_t begin;  // First feature
+    float result;    // 1.0, 0.5 or 0.0 for White
+    int16_t score;   // Search score for White
+    uint8_t count;   // Features
+    uint8_t phase;   // 0 to TOTAL_PHASE
+};
+
+struct Data {
+    std::vector<Position> positions;
+    std::vector<Feature> features;
+};
+
+// The evaluator's constants as a parameter vector; PSQT::init() must have run
+static std::vector<double> currentParams() {
+    std::vector<double> p(PARAM_NB);
+    for (PieceType pt = PAWN; pt <= QUEEN; ++pt) {
+        p[MATERIAL + pt] = PSQT::PIECE_VALUES[pt];
+        for (int i = 0; i < 64; ++i) {
+            p[PST + 64 * pt + i] = PSQT::mg[makePiece(WHITE, pt)][i ^ 56];
+        }
+    }
+    for (int i = 0; i < 64; ++i) {
+        p[KING_MG + i] = PSQT::mg[makePiece(WHITE, KING)][i ^ 56];
+        p[KING_EG + i] = PSQT::eg[makePiece(WHITE, KING)][i ^ 56];
+    }
+    for (int k = 0; k < 2; ++k) {
+        p[DOUBLED + k] = Pawns::DOUBLED[k];
+        p[ISOLATED + k] = Pawns::ISOLATED[k];
+        p[BACKWARD + k] = Pawns::BACKWARD[k];
+    }
+    for (int r = 0; r < 8; ++r) {
+        p[PASSED_MG + r] = Pawns::PASSED_MG[r];
+        p[PASSED_EG + r] = Pawns::PASSED_EG[r];
+    }
+    for (int i = 0; i < 4; ++i) {
+        p[SHELTER + i] = Pawns::SHELTER[i];
+    }
+    p[KING_EXPOSED] = Evaluator::KING_EXPOSED;
+    return p;
+}
+
+// Term counts of a position from White's point of view
+static void countTerms(const Board& board, int* counts) {
+    for (Square s = 0; s < 64; ++s) {
+        Piece p = board.pieceAt(s);
+        if (p == NO_PIECE) continue;
+        
+        int sign = colorOf(p) == WHITE ? 1 : -1;
+        int index = colorOf(p) == WHITE ? s ^ 56 : s;
+        if (typeOf(p) == KING) {
+            counts[KING_MG + index] += sign;
+            counts[KING_EG + index] += sign;
+        } else {
+            counts[MATERIAL + typeOf(p)] += sign;
+            counts[PST + 64 * typeOf(p) + index] += sign;
+        }
+    }
+    
+    // Everything else is recorded by the evaluator as it runs
+    trace = Trace{};
+    trace.kingFile[WHITE] = trace.kingFile[BLACK] = -1;
+    Evaluator::evaluate(board);
+    
+    for (int k = 0; k < 2; ++k) {
+        counts[DOUBLED + k] += trace.doubled;
+        counts[ISOLATED + k] += trace.isolated;
+        counts[BACKWARD + k] += trace.backward;
+    }
+    for (int r = 0; r < 8; ++r) {
+        counts[PASSED_MG + r] += trace.passed[r];
+        counts[PASSED_EG + r] += trace.passed[r];
+    }
+    for (Color c : {WHITE, BLACK}) {
+        if (trace.kingFile[c] < 0) continue;
+        for (int i = 0; i < 4; ++i) {
+            counts[SHELTER + i] += (c == WHITE ? 1 : -1) * trace.shelter[c][trace.kingFile[c]][i];
+        }
+    }
+    counts[KING_EXPOSED] += trace.exposed;
+}
+
+// Evaluation for White from the features
+static double evaluate(const Position& pos, const Feature* features, const double* params) {
+    double mgWeight = pos.phase / double(PSQT::TOTAL_PHASE);
+    const double weights[3] = {1.0, mgWeight, 1.0 - mgWeight};
+    double e = 0;
+    for (int i = 0; i < pos.count; ++i) {
+        const Feature& f = features[i];
+        e += f.count * params[f.param] * weights[tapers[f.param]];
+    }
+    return e;
+}
+
+// "<fen> | <score> | <result>"; false for anything else
+static bool parseLine(const std::string& line, std::string& fen, int& score, float& result) {
+    size_t first = line.find('|');
+    size_t second = first == std::string::npos ? first : line.find('|', first + 1);
+    if (second == std::string::npos) return false;
+    
+    fen = line.substr(0, first);
+    try {
+        score = std::stoi(line.substr(first + 1, second - first - 1));
+        result = std::stof(line.substr(second + 1));
+    } catch (...) {
+        return false;
+    }
+    return result == 0.0f || result == 0.5f || result == 1.0f;
+}
+
+// Positions parsed by one loading thread
+struct Slice {
+    Data data;
+    size_t skipped = 0;     // Lines that are not positions
+    size_t mismatched = 0;  // Features that do not reproduce the evaluator
+};
+
+static void loadSlice(const std::vector<std::string>& lines, size_t begin, size_t end,
+                      const std::vector<double>& params, Slice& slice) {
+    Board board;
+    std::string fen;
+    int counts[PARAM_NB];
+    
+    for (size_t i = begin; i < end; ++i) {
+        Position pos;
+        int score;
+        if (!parseLine(lines[i], fen, score, pos.result)) {
+            slice.skipped++;
+            continue;
+        }
+        board.setFromFEN(fen);
+        
+        std::fill(counts, counts + PARAM_NB, 0);
+        countTerms(board, counts);
+        pos.begin = slice.data.features.size();
+        pos.count = 0;
+        for (int p = 0; p < PARAM_NB; ++p) {
+            if (counts[p]) {
+                slice.data.features.push_back({uint16_t(p), int16_t(counts[p])});
+                pos.count++;
+            }
+        }
+        pos.score = int16_t(std::clamp(score, -30000, 30000));
+        pos.phase = uint8_t(std::min(board.phase(), PSQT::TOTAL_PHASE));
+        
+        // The evaluator rounds each tapered part down, so allow a little
+        Score expected = Evaluator::evaluate(board) * (board.sideToMove() == WHITE ? 1 : -1);
+        double model = evaluate(pos, &slice.data.features[pos.begin], params.data());
+        if (std::abs(model - expected) > 3) slice.mismatched++;
+        
+        slice.data.positions.push_back(pos);
+    }
+}
+
+// Parse the training file on all threads into one feature array
+static bool load(const Options& options, const std::vector<double>& params, Data& data,
+                 size_t& skipped, size_t& mismatched) {
+    std::ifstream in(options.input);
+    if (!in) return false;
+    
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty()) lines.push_back(std::move(line));
+    }
+    
+    std::vector<Slice> slices(options.threads);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < options.threads; ++t) {
+        size_t begin = lines.size() * t / options.threads;
+        size_t end = lines.size() * (t + 1) / options.threads;
+        workers.emplace_back(loadSlice, std::cref(lines), begin, end, std::cref(params), std::ref(slices[t]));
+    }
+    for (std::thread& w : workers) {
+        w.join();
+    }
+    
+    skipped = mismatched = 0;
+    for (Slice& slice : slices) {
+        uint32_t offset = data.features.size();
+        for (Position& pos : slice.data.positions) {
+            pos.begin += offset;
+            data.positions.push_back(pos);
+        }
+        data.features.insert(data.features.end(), slice.data.features.begin(), slice.data.features.end());
+        skipped += slice.skipped;
+        mismatched += slice.mismatched;
+        slice.data = Data();
+    }
+    return true;
+}
+
+static double sigmoid(double K, double score) {
+    return 1.0 / (1.0 + std::pow(10.0, -K * score / 400.0));
+}
+
+// Squared error summed over positions [begin, end); adds its gradient to
+// grad when given
+static double errorSum(const Data& data, size_t begin, size_t end, const double* params,
+                       double K, double lambda, double* grad) {
+    const double slope = K * std::log(10.0) / 400.0;
+    double sum = 0;
+    for (size_t i = begin; i < end; ++i) {
+        const Position& pos = data.positions[i];
+        const Feature* features = &data.features[pos.begin];
+        double s = sigmoid(K, evaluate(pos, features, params));
+        double target = lambda * pos.result + (1.0 - lambda) * sigmoid(K, pos.score);
+        double error = s - target;
+        sum += error * error;
+        
+        if (grad) {
+            double mgWeight = pos.phase / double(PSQT::TOTAL_PHASE);
+            const double weights[3] = {1.0, mgWeight, 1.0 - mgWeight};
+            double d = 2.0 * error * s * (1.0 - s) * slope;
+            for (int j = 0; j < pos.count; ++j) {
+                const Feature& f = features[j];
+                grad[f.param] += d * f.count * weights[tapers[f.param]];
+            }
+        }
+    }
+    return sum;
+}
+
+// Mean squared error over all positions, split across threads; fills grad
+// with its gradient when given
+static double loss(const Data& data, const std::vector<double>& params, double K,
+                   const Options& options, std::vector<double>* grad = nullptr) {
+    int threads = options.threads;
+    size_t n = data.positions.size();
+    std::vector<double> sums(threads);
+    std::vector<std::vector<double>> grads(grad ? threads : 0, std::vector<double>(PARAM_NB));
+    
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            sums[t] = errorSum(data, n * t / threads, n * (t + 1) / threads, params.data(),
+                               K, options.lambda, grad ? grads[t].data() : nullptr);
+        });
+    }
+    for (std::thread& w : workers) {
+        w.join();
+    }
+    
+    if (grad) {
+        grad->assign(PARAM_NB, 0.0);
+        for (const auto& g : grads) {
+            for (int i = 0; i < PARAM_NB; ++i) (*grad)[i] += g[i] / n;
+        }
+    }
+    double total = 0;
+    for (double s : sums) total += s;
+    return total / n;
+}
+
+// Scaling of scores to expected results that fits the current evaluation
+// best, by golden section search
+static double fitK(const Data& data, const std::vector<double>& params, const Options& options) {
+    const double ratio = (std::sqrt(5.0) - 1.0) / 2.0;
+    double lo = 0.05, hi = 5.0;
+    double a = hi - ratio * (hi - lo), b = lo + ratio * (hi - lo);
+    double la = loss(data, params, a, options), lb = loss(data, params, b, options);
+    for (int i = 0; i < 40; ++i) {
+        if (la < lb) {
+            hi = b; b = a; lb = la;
+            a = hi - ratio * (hi - lo);
+            la = loss(data, params, a, options);
+        } else {
+            lo = a; a = b; la = lb;
+            b = lo + ratio * (hi - lo);
+            lb = loss(data, params, b, options);
+        }
+    }
+    return (lo + hi) / 2;
+}
+
+static void printArray(const char* declaration, const double* values, int n) {
+    std::cout << declaration << " = {";
+    for (int i = 0; i < n; ++i) {
+        std::cout << (i ? ", " : "") << std::lround(values[i]);
+    }
+    std::cout << "};\n";
+}
+
+static void printTable(const char* name, const double* values) {
+    std::cout << "static const Score " << name << "[64] = {\n";
+    for (int rank = 0; rank < 8; ++rank) {
+        std::cout << "   ";
+        for (int file = 0; file < 8; ++file) {
+            int i = 8 * rank + file;
+            std::cout << std::setw(4) << std::lround(values[i]) << (i < 63 ? "," : "");
+        }
+        std::cout << "\n";
+    }
+    std::cout << "};\n\n";
+}
+
+// The parameters in the form they are declared in the source
+static void printParams(const std::vector<double>& p) {
+    const double material[6] = {p[MATERIAL + PAWN], p[MATERIAL + KNIGHT], p[MATERIAL + BISHOP],
+                                p[MATERIAL + ROOK], p[MATERIAL + QUEEN], 0};
+    std::cout << "// psqt.h\n";
+    printArray("constexpr Score PIECE_VALUES[6]", material, 6);
+    
+    static const char* const TABLES[5] = {"PAWN_PST", "KNIGHT_PST", "BISHOP_PST", "ROOK_PST", "QUEEN_PST"};
+    std::cout << "\n// psqt.cpp\n";
+    for (PieceType pt = PAWN; pt <= QUEEN; ++pt) {
+        printTable(TABLES[pt], &p[PST + 64 * pt]);
+    }
+    printTable("KING_PST", &p[KING_MG]);
+    printTable("KING_ENDGAME_PST", &p[KING_EG]);
+    
+    std::cout << "// pawns.h\n";
+    printArray("constexpr Score DOUBLED[2]", &p[DOUBLED], 2);
+    printArray("constexpr Score ISOLATED[2]", &p[ISOLATED], 2);
+    printArray("constexpr Score BACKWARD[2]", &p[BACKWARD], 2);
+    printArray("constexpr Score PASSED_MG[8]", &p[PASSED_MG], 8);
+    printArray("constexpr Score PASSED_EG[8]", &p[PASSED_EG], 8);
+    printArray("constexpr Score SHELTER[4]", &p[SHELTER], 4);
+    
+    std::cout << "\n// evaluation.h\n";
+    std::cout << "static constexpr Score KING_EXPOSED = " << std::lround(p[KING_EXPOSED]) << ";" << std::endl;
+}
+
+int run(const Options& opts) {
+    Options options = opts;
+    options.threads = std::max(1, options.threads);
+    
+    // The first Board fills the tables every thread reads
+    Board().reset();
+    for (int i = 0; i < PARAM_NB; ++i) {
+        tapers[i] = taperOf(i);
+    }
+    std::vector<double> params = currentParams();
+    
+    auto start = std::chrono::steady_clock::now();
+    Data data;
+    size_t skipped, mismatched;
+    if (!load(options, params, data, skipped, mismatched) || data.positions.empty()) {
+        std::cerr << "No positions in " << options.input << std::endl;
+        return 1;
+    }
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    size_t bytes = data.positions.size() * sizeof(Position) + data.features.size() * sizeof(Feature);
+    std::cerr << "Loaded " << data.positions.size() << " positions (" << bytes / (1024 * 1024) << " MB) in "
+              << ms << " ms, " << skipped << " lines skipped" << std::endl;
+    if (mismatched) {
+        std::cerr << "Warning: " << mismatched << " positions not matching the evaluator" << std::endl;
+    }
+    
+    double K = fitK(data, params, options);
+    double initialLoss = loss(data, params, K, options);
+    std::cerr << "K " << K << ", loss " << initialLoss << std::endl;
+    
+    // Adam, one step per full pass
+    const double beta1 = 0.9, beta2 = 0.999;
+    std::vector<double> m(PARAM_NB), v(PARAM_NB), grad;
+    double e = initialLoss;
+    for (int it = 1; it <= options.iterations; ++it) {
+        e = loss(data, params, K, options, &grad);
+        for (int i = 0; i < PARAM_NB; ++i) {
+            m[i] = beta1 * m[i] + (1 - beta1) * grad[i];
+            v[i] = beta2 * v[i] + (1 - beta2) * grad[i] * grad[i];
+            double mHat = m[i] / (1 - std::pow(beta1, it));
+            double vHat = v[i] / (1 - std::pow(beta2, it));
+            params[i] -= options.learningRate * mHat / (std::sqrt(vHat) + 1e-8);
+        }
+        if (it % 50 == 0 || it == options.iterations) {
+            std::cerr << "Iteration " << it << ", loss " << e << std::endl;
+        }
+    }
+    
+    std::cout << "// Tuned on " << data.positions.size() << " positions, K " << K << ", loss "
+              << initialLoss << " -> " << loss(data, params, K, options) << "\n\n";
+    printParams(params);
+    return 0;
+}
+
+}
+
+#endif // TUNE
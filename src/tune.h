@@ -0,0 +1,54 @@
+#ifndef TUNE_H
+#define TUNE_H
+
+// Texel tuning of the hand-written evaluation, compiled in with -DTUNE
+// (make tune). Without it the trace macros below expand to nothing.
+//
+// The evaluation is linear in its terms once the game phase is known, so
+// each training position is reduced once, on loading, to a short list of
+// (term, count) pairs. Loss and gradient passes then only walk those lists,
+// split across threads; no Board is rebuilt while tuning.
+
+#ifdef TUNE
+
+#include <string>
+
+namespace Tune {
+
+// Terms that are not a plain function of where the pieces stand, counted
+// while the evaluator runs. Counts are white minus black unless noted.
+struct Trace {
+    int doubled, isolated, backward;
+    int passed[8];           // By relative rank
+    int shelter[2][8][4];    // By color, king file and shelter index
+    int kingFile[2];         // File of a king sheltered at home, -1 otherwise
+    int exposed;             // Kings away from home
+};
+
+// This thread's trace, cleared by the tuner before each evaluation
+extern thread_local Trace trace;
+
+struct Options {
+    std::string input;        // Datagen output: "<fen> | <score> | <result>"
+    int iterations = 1000;    // Full passes over the data
+    int threads = 1;
+    double lambda = 1.0;      // Weight of the game result against the search score
+    double learningRate = 1.0;
+};
+
+// Prints the tuned constants on stdout; returns 1 if there is no data
+int run(const Options& options);
+
+}
+
+#define TUNE_ADD(term, n) (Tune::trace.term += (n))
+#define TUNE_SET(term, v) (Tune::trace.term = (v))
+
+#else
+
+#define TUNE_ADD(term, n) ((void)0)
+#define TUNE_SET(term, v) ((void)0)
+
+#endif // TUNE
+
+#endif // TUNE_H
@@ -52,12 +52,13 @@ constexpr Piece NO_PIECE = 12;
 constexpr Square A1 = 0, B1 = 1, C1 = 2, D1 = 3, E1 = 4, F1 = 5, G1 = 6, H1 = 7;
 constexpr Square A8 = 56, B8 = 57, C8 = 58, D8 = 59, E8 = 60, F8 = 61, G8 = 62, H8 = 63;
 
-// Move flags
+// Move flags (bits 12-15). Bit 15 marks a promotion, bit 14 a capture;
+// bits 12-13 hold the promotion piece, or the special move kind otherwise.
 constexpr uint16_t MOVE_NORMAL = 0;
+constexpr uint16_t MOVE_CASTLE = 2 << 12;
 constexpr uint16_t MOVE_CAPTURE = 1 << 14;
-constexpr uint16_t MOVE_CASTLE = 1 << 15;
-constexpr uint16_t MOVE_EN_PASSANT = (1 << 14) | (1 << 15);
-constexpr uint16_t MOVE_PROMOTION = 1 << 13;
+constexpr uint16_t MOVE_EN_PASSANT = MOVE_CAPTURE | (1 << 12);
+constexpr uint16_t MOVE_PROMOTION = 1 << 15;
 
 // Castling rights
 constexpr int WHITE_KINGSIDE = 1;
@@ -1,10 +1,37 @@
 #include "uci.h"
-#include "movegen.h"
+#include "movegen_fast.h"
+#include "nnue.h"
+#include "numa.h"
+#include "perft.h"
+#include "stats.h"
+#include "syzygy.h"
 #include "utils.h"
+#include <algorithm>
+#include <iomanip>
 #include <iostream>
 #include <sstream>
 
-UCI::UCI() : search(nullptr) {
+// Pruning switches, as UCI check options
+static const std::vector<std::pair<std::string, bool SearchParams::*>>& searchOptions() {
+    static const std::vector<std::pair<std::string, bool SearchParams::*>> options = {
+        {"NullMove", &SearchParams::nullMove},
+        {"LMR", &SearchParams::lmr},
+        {"ReverseFutility", &SearchParams::reverseFutility},
+        {"Razoring", &SearchParams::razoring},
+        {"Futility", &SearchParams::futility},
+        {"LateMovePruning", &SearchParams::lateMovePruning},
+    };
+    return options;
+}
+
+static bool isSearchOption(const std::string& name) {
+    for (const auto& option : searchOptions()) {
+        if (option.first == name) return true;
+    }
+    return false;
+}
+
+UCI::UCI() {
     board.reset();
 }
 
@@ -12,7 +39,6 @@ UCI::~UCI() {
     if (searchThread.joinable()) {
         searchThread.join();
     }
-    delete search;
 }
 
 void UCI::loop() {
@@ -34,14 +60,22 @@ void UCI::loop() {
             handleGo(line);
         } else if (command == "stop") {
             handleStop();
+        } else if (command == "ponderhit") {
+            threads.ponderHit();
         } else if (command == "quit") {
             handleQuit();
             break;
         } else if (command == "setoption") {
             handleSetOption(line);
+        } else if (command == "debug") {
+            handleDebug(line);
+        } else if (command == "perft") {
+            handlePerft(line);
         } else if (command == "d") {
             // Debug: display board
             std::cout << board.toFEN() << std::endl;
+            std::cout << "Key: " << std::hex << std::setw(16) << std::setfill('0')
+                      << board.getHash() << std::dec << std::setfill(' ') << std::endl;
         }
     }
 }
@@ -51,7 +85,21 @@ void UCI::handleUCI() {
     std::cout << "id author YourName" << std::endl;
     
     // Options can be added here
-    std::cout << "option name Hash type spin default 64 min 1 max 1024" << std::endl;
+    std::cout << "option name Hash type spin default " << TranspositionTable::DEFAULT_MB
+              << " min 1 max 65536" << std::endl;
+    std::cout << "option name Threads type spin default 1 min 1 max 256" << std::endl;
+    std::cout << "option name NumaBind type check default false" << std::endl;
+    std::cout << "option name EvalFile type string default <empty>" << std::endl;
+    std::cout << "option name Move Overhead type spin default 30 min 0 max 5000" << std::endl;
+    std::cout << "option name MultiPV type spin default 1 min 1 max 256" << std::endl;
+    std::cout << "option name SyzygyPath type string default <empty>" << std::endl;
+    std::cout << "option name Ponder type check default false" << std::endl;
+    std::cout << "option name OwnBook type check default false" << std::endl;
+    std::cout << "option name BookFile type string default <empty>" << std::endl;
+    for (const auto& option : searchOptions()) {
+        std::cout << "option name " << option.first << " type check default "
+                  << (threads.params.*option.second ? "true" : "false") << std::endl;
+    }
     
     std::cout << "uciok" << std::endl;
 }
@@ -61,11 +109,9 @@ void UCI::handleIsReady() {
 }
 
 void UCI::handleUCINewGame() {
+    handleStop();
     board.reset();
-    if (search) {
-        delete search;
-        search = nullptr;
-    }
+    threads.clear();
 }
 
 void UCI::handlePosition(const std::string& line) {
@@ -91,6 +137,7 @@ void UCI::handlePosition(const std::string& line) {
         while (idx < tokens.size()) {
             Move m = parseMove(tokens[idx]);
             if (m != 0) {
+                if (board.gamePly() >= Board::MAX_GAME_PLIES) board.trimHistory();
                 board.makeMove(m);
             }
             idx++;
@@ -103,121 +150,103 @@ void UCI::handleGo(const std::string& line) {
         searchThread.join();
     }
     
-    std::vector<std::string> tokens = split(line);
-    int depth = 64; // Default max depth
-    int timeLimit = 0;
-    bool infinite = false;
+    // The clock runs from here, before the search thread starts
+    SearchLimits limits;
+    limits.moveOverhead = moveOverhead;
+    limits.multiPV = multiPV;
     
-    // Time management variables
-    int myTime = 0;
-    int myInc = 0;
-    int opTime = 0;
-    int opInc = 0;
-    int movesToGo = 40; // Assume 40 moves to time control if not specified
+    bool ponder = false;
     
+    std::vector<std::string> tokens = split(line);
     for (size_t i = 1; i < tokens.size(); i++) {
-        if (tokens[i] == "depth" && i + 1 < tokens.size()) {
-            depth = std::stoi(tokens[i + 1]);
-        } else if (tokens[i] == "infinite") {
-            infinite = true;
-        } else if (tokens[i] == "movetime" && i + 1 < tokens.size()) {
-            timeLimit = std::stoi(tokens[i + 1]);
-        } else if (tokens[i] == "wtime" && i + 1 < tokens.size()) {
-            int wtime = std::stoi(tokens[i + 1]);
-            if (board.sideToMove() == WHITE) {
-                myTime = wtime;
-            } else {
-                opTime = wtime;
-            }
-        } else if (tokens[i] == "btime" && i + 1 < tokens.size()) {
-            int btime = std::stoi(tokens[i + 1]);
-            if (board.sideToMove() == BLACK) {
-                myTime = btime;
-            } else {
-                opTime = btime;
-            }
-        } else if (tokens[i] == "winc" && i + 1 < tokens.size()) {
-            int winc = std::stoi(tokens[i + 1]);
-            if (board.sideToMove() == WHITE) {
-                myInc = winc;
-            } else {
-                opInc = winc;
-            }
-        } else if (tokens[i] == "binc" && i + 1 < tokens.size()) {
-            int binc = std::stoi(tokens[i + 1]);
-            if (board.sideToMove() == BLACK) {
-                myInc = binc;
-            } else {
-                opInc = binc;
-            }
-        } else if (tokens[i] == "movestogo" && i + 1 < tokens.size()) {
-            movesToGo = std::stoi(tokens[i + 1]);
+        const std::string& token = tokens[i];
+        if (token == "infinite") {
+            limits.infinite = true;
+            continue;
+        }
+        if (token == "ponder") {
+            ponder = true;
+            continue;
+        }
+        if (i + 1 >= tokens.size()) break;
+        
+        if (token == "depth") {
+            limits.depth = std::stoi(tokens[++i]);
+        } else if (token == "nodes") {
+            limits.nodes = std::stoull(tokens[++i]);
+        } else if (token == "movetime") {
+            limits.moveTime = std::stoll(tokens[++i]);
+        } else if (token == "wtime") {
+            limits.time[WHITE] = std::stoll(tokens[++i]);
+        } else if (token == "btime") {
+            limits.time[BLACK] = std::stoll(tokens[++i]);
+        } else if (token == "winc") {
+            limits.inc[WHITE] = std::stoll(tokens[++i]);
+        } else if (token == "binc") {
+            limits.inc[BLACK] = std::stoll(tokens[++i]);
+        } else if (token == "movestogo") {
+            limits.movesToGo = std::stoi(tokens[++i]);
         }
     }
     
-    // Calculate time limit if not explicitly set
-    if (timeLimit == 0 && !infinite && myTime > 0) {
-        // Basic time management formula
-        // Reserve some time for safety
-        int safetyTime = 50; // 50ms safety margin
-        int availableTime = myTime - safetyTime;
-        
-        if (availableTime > 0) {
-            // Base time calculation
-            if (movesToGo > 0) {
-                // We have a specific number of moves to make
-                timeLimit = availableTime / movesToGo;
-            } else {
-                // Assume we need to make ~30 more moves
-                timeLimit = availableTime / 30;
-            }
-            
-            // Add increment consideration
-            // Use most of the increment but keep some safety margin
-            if (myInc > 0) {
-                timeLimit += myInc * 9 / 10; // Use 90% of increment
-            }
-            
-            // Adjust based on game phase (simple heuristic)
-            int moveNum = board.fullmoveNumber();
-            if (moveNum < 10) {
-                // Opening: use a bit more time
-                timeLimit = timeLimit * 12 / 10;
-            } else if (moveNum > 40) {
-                // Endgame: use less time per move
-                timeLimit = timeLimit * 8 / 10;
-            }
-            
-            // Never use more than 1/4 of remaining time on a single move
-            int maxTime = availableTime / 4;
-            if (timeLimit > maxTime) {
-                timeLimit = maxTime;
-            }
-            
-            // Minimum time per move
-            if (timeLimit < 10) {
-                timeLimit = 10;
-            }
+    // Known book positions are answered at once, without a search
+    if (ownBook && !limits.infinite && !ponder) {
+        if (Move bookMove = book.probe(board)) {
+            printBestMove(bookMove);
+            return;
         }
     }
     
-    // Debug output
-    std::cerr << "Time management: myTime=" << myTime << " myInc=" << myInc 
-              << " movesToGo=" << movesToGo << " -> timeLimit=" << timeLimit << "ms" << std::endl;
+    // Set here rather than on the search thread, so that a ponderhit
+    // sent right after this command is not lost
+    threads.pondering = ponder;
     
     // Start search in a separate thread
-    searchThread = std::thread([this, depth, timeLimit, infinite]() {
-        if (!search) {
-            search = new Search(board);
-        }
-        Move bestMove = search->think(depth, timeLimit, infinite);
-        printBestMove(bestMove);
+    // The position is copied now, so later commands cannot change it mid-search
+    searchThread = std::thread([this, position = board, limits]() {
+        Move bestMove = threads.think(position, limits);
+        printBestMove(bestMove, threads.ponderMove());
     });
 }
-void UCI::handleStop() {
-    if (search) {
-        search->stopSearch();
+
+void UCI::handlePerft(const std::string& line) {
+    // perft <depth> [hash <MB>], split over the Threads option
+    std::vector<std::string> tokens = split(line);
+    if (tokens.size() < 2) return;
+    handleStop();
+    
+    Perft::Options options;
+    options.threads = threads.size();
+    if (tokens.size() > 3 && tokens[2] == "hash") {
+        options.hashMB = std::stoul(tokens[3]);
     }
+    
+    auto start = std::chrono::steady_clock::now();
+    uint64_t nodes = Perft::divide(board, std::stoi(tokens[1]), options);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    int64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+    std::cout << "Time: " << ms << " ms";
+    if (ms > 0) std::cout << ", " << nodes * 1000 / ms << " nps";
+    std::cout << std::endl;
+}
+
+void UCI::handleDebug(const std::string& line) {
+    // debug stats [clear]: search counters since start or the last clear
+    std::vector<std::string> tokens = split(line);
+    if (tokens.size() < 2 || tokens[1] != "stats") return;
+#ifdef SEARCH_STATS
+    if (tokens.size() > 2 && tokens[2] == "clear") {
+        Stats::clear();
+    } else {
+        Stats::print(std::cout);
+    }
+#else
+    std::cout << "info string search stats not compiled in, build with make STATS=yes" << std::endl;
+#endif
+}
+
+void UCI::handleStop() {
+    threads.stopSearch();
     if (searchThread.joinable()) {
         searchThread.join();
     }
@@ -228,8 +257,74 @@ void UCI::handleQuit() {
 }
 
 void UCI::handleSetOption(const std::string& line) {
-    // Parse and handle options
-    // For now, we'll ignore options
+    // setoption name <id> [value <x>]; option names may contain spaces
+    std::vector<std::string> tokens = split(line);
+    std::string name, value;
+    std::string* field = nullptr;
+    for (size_t i = 1; i < tokens.size(); i++) {
+        if (tokens[i] == "name") {
+            field = &name;
+        } else if (tokens[i] == "value") {
+            field = &value;
+        } else if (field) {
+            if (!field->empty()) *field += " ";
+            *field += tokens[i];
+        }
+    }
+    
+    if (name == "Hash" && !value.empty()) {
+        handleStop();
+        size_t requested = std::max(1, std::min(65536, std::stoi(value)));
+        size_t allocated = threads.tt.resize(requested, threads.size());
+        if (allocated < requested) {
+            std::cout << "info string failed to allocate " << requested << " MB of hash, using "
+                      << allocated << " MB" << std::endl;
+        }
+    } else if (name == "Threads" && !value.empty()) {
+        handleStop();
+        threads.setThreadCount(std::max(1, std::min(256, std::stoi(value))));
+    } else if (name == "NumaBind" && !value.empty()) {
+        // Helpers bind themselves when they start, so restart them
+        handleStop();
+        Numa::setBinding(value == "true");
+        threads.setThreadCount(threads.size());
+        if (Numa::binding()) {
+            std::cout << "info string NUMA binding over " << Numa::nodeCount() << " node(s)" << std::endl;
+        }
+    } else if (name == "Move Overhead" && !value.empty()) {
+        moveOverhead = std::max(0, std::min(5000, std::stoi(value)));
+    } else if (name == "MultiPV" && !value.empty()) {
+        multiPV = std::max(1, std::min(256, std::stoi(value)));
+    } else if (isSearchOption(name) && !value.empty()) {
+        handleStop();
+        for (const auto& option : searchOptions()) {
+            if (option.first == name) threads.params.*option.second = value == "true";
+        }
+    } else if (name == "OwnBook" && !value.empty()) {
+        ownBook = value == "true";
+    } else if (name == "BookFile") {
+        handleStop();
+        if (value.empty() || value == "<empty>") {
+            book.close();
+        } else if (book.open(value)) {
+            std::cout << "info string book " << value << " (" << book.size() << " entries)" << std::endl;
+        } else {
+            std::cout << "info string failed to open book " << value << std::endl;
+        }
+    } else if (name == "SyzygyPath") {
+        handleStop();
+        Syzygy::init(value);
+        if (Syzygy::maxPieces() > 0) {
+            std::cout << "info string Syzygy tablebases up to " << Syzygy::maxPieces() << " pieces" << std::endl;
+        }
+    } else if (name == "EvalFile") {
+        handleStop();
+        if (!NNUE::load(value)) {
+            std::cout << "info string failed to load network " << value << std::endl;
+        } else if (NNUE::enabled()) {
+            std::cout << "info string NNUE " << value << " (" << NNUE::simdName() << ")" << std::endl;
+        }
+    }
 }
 
 void UCI::printInfo(const SearchInfo& info) {
@@ -257,8 +352,12 @@ void UCI::printInfo(const SearchInfo& info) {
     std::cout << std::endl;
 }
 
-void UCI::printBestMove(Move m) {
-    std::cout << "bestmove " << MoveUtils::toString(m) << std::endl;
+void UCI::printBestMove(Move m, Move ponder) {
+    std::cout << "bestmove " << MoveUtils::toString(m);
+    if (ponder) {
+        std::cout << " ponder " << MoveUtils::toString(ponder);
+    }
+    std::cout << std::endl;
 }
 
 Move UCI::parseMove(const std::string& str) {
@@ -273,8 +372,8 @@ Move UCI::parseMove(const std::string& str) {
     Square to = makeSquare(toFile, toRank);
     
     // Generate legal moves to find the matching move
-    std::vector<Move> moves;
-    MoveGenerator::generateLegalMoves(board, moves);
+    MoveList moves;
+    DefaultMoveGenerator::generateLegalMoves(board, moves);
     
     for (Move m : moves) {
         if (MoveUtils::from(m) == from && MoveUtils::to(m) == to) {
@@ -2,7 +2,8 @@
 #define UCI_H
 
 #include "board.h"
-#include "search.h"
+#include "book.h"
+#include "thread.h"
 #include <string>
 #include <thread>
 
@@ -13,11 +14,15 @@ public:
     
     // Main UCI loop
     void loop();
-    
+
 private:
     Board board;
-    Search* search;
+    ThreadPool threads;
     std::thread searchThread;
+    int moveOverhead = 30; // Milliseconds, the Move Overhead option
+    int multiPV = 1;       // Lines to report, the MultiPV option
+    Book book;
+    bool ownBook = false;
     
     // UCI command handlers
     void handleUCI();
@@ -25,13 +30,15 @@ private:
     void handleUCINewGame();
     void handlePosition(const std::string& line);
     void handleGo(const std::string& line);
+    void handlePerft(const std::string& line);
+    void handleDebug(const std::string& line);
     void handleStop();
     void handleQuit();
     void handleSetOption(const std::string& line);
     
     // Helper methods
     void printInfo(const SearchInfo& info);
-    void printBestMove(Move m);
+    void printBestMove(Move m, Move ponder = 0);
     Move parseMove(const std::string& str);
     int parseTime(const std::string& line, const std::string& token);
 };
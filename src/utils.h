@@ -1,6 +1,7 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <sstream>
@@ -31,6 +32,13 @@ inline int msb(uint64_t b) {
     return 63 - __builtin_clzll(b);
 }
 
+// Returns the least significant set bit and clears it
+inline int popLsb(uint64_t& b) {
+    int s = lsb(b);
+    b &= b - 1;
+    return s;
+}
+
 // Random number generation (for Zobrist hashing)
 inline uint64_t random64() {
     static uint64_t seed = 1070372ull;
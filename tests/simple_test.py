@@ -90,9 +90,12 @@ class GameManager:
         "position startpos moves c2c4",
     ]
     
-    def __init__(self, engine1_path, engine2_path, time_ms=10000, inc_ms=100):
+    def __init__(self, engine1_path, engine2_path, time_ms=10000, inc_ms=100,
+                 engine1_options=None, engine2_options=None):
         self.engine1_path = engine1_path
         self.engine2_path = engine2_path
+        self.engine1_options = engine1_options or {}
+        self.engine2_options = engine2_options or {}
         self.initial_time_ms = time_ms
         self.inc_ms = inc_ms
         
@@ -138,6 +141,12 @@ class GameManager:
             engine1.receive_until('uciok')
             engine2.receive_until('uciok')
             
+            # UCI options, e.g. to switch off one pruning technique
+            for name, value in self.engine1_options.items():
+                engine1.send(f'setoption name {name} value {value}')
+            for name, value in self.engine2_options.items():
+                engine2.send(f'setoption name {name} value {value}')
+            
             # New game
             engine1.send('ucinewgame')
             engine2.send('ucinewgame')
@@ -242,6 +251,8 @@ class SimpleTester:
         self.concurrency = kwargs.get('concurrency', 1)
         self.time_ms = kwargs.get('time_ms', 10000)
         self.inc_ms = kwargs.get('inc_ms', 100)
+        self.base_options = kwargs.get('base_options', {})
+        self.test_options = kwargs.get('test_options', {})
         
         # Results
         self.wins = 0
@@ -256,7 +267,8 @@ class SimpleTester:
         
     def run_games(self, game_indices):
         """Worker function to run games"""
-        manager = GameManager(self.test_engine, self.base_engine, self.time_ms, self.inc_ms)
+        manager = GameManager(self.test_engine, self.base_engine, self.time_ms, self.inc_ms,
+                              self.test_options, self.base_options)
         
         for i in game_indices:
             try:
@@ -418,6 +430,8 @@ class SimpleTester:
             'los': los,
             'time_seconds': elapsed,
             'time_control': f"{self.time_ms}+{self.inc_ms}",
+            'base_options': self.base_options,
+            'test_options': self.test_options,
             'timestamp': datetime.now().isoformat()
         }
         
@@ -435,6 +449,8 @@ def main():
         print("  --concurrency N Number of concurrent games (default: 1)")
         print("  --time MS      Initial time per game in milliseconds (default: 10000)")
         print("  --inc MS       Increment per move in milliseconds (default: 100)")
+        print("  --base-option NAME=VALUE  UCI option for the base engine (repeatable)")
+        print("  --test-option NAME=VALUE  UCI option for the test engine (repeatable)")
         sys.exit(1)
         
     base_engine = sys.argv[1]
@@ -445,7 +461,9 @@ def main():
         'num_games': 100,
         'concurrency': 1,
         'time_ms': 10000,
-        'inc_ms': 100
+        'inc_ms': 100,
+        'base_options': {},
+        'test_options': {}
     }
     
     i = 3
@@ -462,6 +480,11 @@ def main():
         elif sys.argv[i] == '--inc' and i + 1 < len(sys.argv):
             kwargs['inc_ms'] = int(sys.argv[i + 1])
             i += 2
+        elif sys.argv[i] in ('--base-option', '--test-option') and i + 1 < len(sys.argv):
+            name, _, value = sys.argv[i + 1].partition('=')
+            key = 'base_options' if sys.argv[i] == '--base-option' else 'test_options'
+            kwargs[key][name] = value
+            i += 2
         else:
             i += 1
             